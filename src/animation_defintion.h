@@ -96,6 +96,8 @@ struct AnimationDefinition
     float c5 = 1.3962634015954636;
     float n1 = 7.5625;
     float d1 = 2.75;
+
+    bool operator==(AnimationDefinition const&) const = default;
 };
 
 AnimateableEvent from_string_animateable_event(std::string const&);
@@ -397,7 +397,8 @@ void Animator::window_move(
 {
     // If animations aren't enabled, let's give them the position that
     // they want to go to immediately and don't bother animating anything.
-    if (!config->are_animations_enabled())
+    auto const options = config->snapshot();
+    if (!options->animations_enabled)
     {
         callback(
             { handle,
@@ -410,7 +411,7 @@ void Animator::window_move(
 
     append(Animation(
         handle,
-        config->get_animation_definitions()[(int)AnimateableEvent::window_move],
+        options->animation_defintions[(int)AnimateableEvent::window_move],
         from,
         to,
         current,
@@ -423,7 +424,8 @@ void Animator::window_open(
 {
     // If animations aren't enabled, let's give them the position that
     // they want to go to immediately and don't bother animating anything.
-    if (!config->are_animations_enabled())
+    auto const options = config->snapshot();
+    if (!options->animations_enabled)
     {
         callback({ handle, true });
         return;
@@ -431,7 +433,7 @@ void Animator::window_open(
 
     append(Animation(
         handle,
-        config->get_animation_definitions()[(int)AnimateableEvent::window_open],
+        options->animation_defintions[(int)AnimateableEvent::window_open],
         std::nullopt,
         std::nullopt,
         std::nullopt,
@@ -445,7 +447,8 @@ void Animator::workspace_switch(
     mir::geometry::Rectangle const& current,
     std::function<void(AnimationStepResult const&)> const& callback)
 {
-    if (!config->are_animations_enabled())
+    auto const options = config->snapshot();
+    if (!options->animations_enabled)
     {
         callback(
             { handle,
@@ -458,7 +461,7 @@ void Animator::workspace_switch(
 
     append(Animation(
         handle,
-        config->get_animation_definitions()[(int)AnimateableEvent::workspace_switch],
+        options->animation_defintions[(int)AnimateableEvent::workspace_switch],
         from,
         to,
         current,
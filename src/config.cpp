@@ -19,8 +19,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MIR_LOG_COMPONENT "config"
 
 #include "config.h"
+#include "config_cache.h"
+#include "key_binding_table.h"
 #include "yaml-cpp/node/node.h"
 #include "yaml-cpp/yaml.h"
+#include <algorithm>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
@@ -31,7 +34,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <mir/options/option.h>
 #include <mir/server.h>
 #include <miral/runner.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
+#include <sys/timerfd.h>
 
 using namespace miracle;
 
@@ -39,6 +44,9 @@ namespace
 {
 const char* MIRACLE_DEFAULT_CONFIG_DIR = "/usr/share/miracle-wm/default-config";
 
+/// How long the config file must go without changes before it is reloaded.
+long const reload_debounce_ms = 150;
+
 int program_exists(std::string const& name)
 {
     std::stringstream out;
@@ -154,7 +162,8 @@ FilesystemConfiguration::FilesystemConfiguration(miral::MirRunner& runner) :
 FilesystemConfiguration::FilesystemConfiguration(
     miral::MirRunner& runner, std::string const& path, bool load_immediately) :
     runner { runner },
-    default_config_path { path }
+    default_config_path { path },
+    details { std::make_shared<ConfigDetails const>() }
 {
     if (load_immediately)
     {
@@ -165,6 +174,12 @@ FilesystemConfiguration::FilesystemConfiguration(
     }
 }
 
+FilesystemConfiguration::~FilesystemConfiguration()
+{
+    if (reload_thread.joinable())
+        reload_thread.join();
+}
+
 void FilesystemConfiguration::load(mir::Server& server)
 {
     const char* config_file_name_option = "config";
@@ -251,41 +266,30 @@ void FilesystemConfiguration::_init(std::optional<StartupApp> const& systemd_app
         }
     }
 
-    _reload();
-
-    // If the user specified an --systemd-session-configure <APP_NAME>, let's add that to the list
-    if (systemd_app)
-    {
-        options.startup_apps.insert(options.startup_apps.begin(), systemd_app.value());
-    }
-
-    // If the user specified an --exec <APP_NAME>, let's add that to the list
+    this->systemd_app = systemd_app;
+    this->exec_app = exec_app;
     if (exec_app)
-    {
         mir::log_info("Miracle will die when the application specified with --exec dies");
-        options.startup_apps.push_back(exec_app.value());
-    }
+
+    _publish(_load());
+    last_notified = details.load();
 
     is_loaded_ = true;
     _watch(runner);
 }
 
-void FilesystemConfiguration::_reload()
+ConfigDetails FilesystemConfiguration::_parse(std::string const& contents) const
 {
-    std::lock_guard<std::mutex> lock(mutex);
-
-    // Reset all
-    options = ConfigDetails();
-
+    ConfigDetails options;
     if (no_config)
     {
         mir::log_info("No configuration was specified, so the config will not load.");
-        return;
+        return options;
     }
 
     // Load the new configuration
     mir::log_info("Configuration is loading...");
-    YAML::Node config = YAML::LoadFile(config_path);
+    YAML::Node config = YAML::Load(contents);
     if (config["action_key"])
     {
         auto const stringified_action_key = config["action_key"].as<std::string>();
@@ -302,7 +306,7 @@ void FilesystemConfiguration::_reload()
         if (!default_action_overrides.IsSequence())
         {
             mir::log_error("default_action_overrides: value must be an array");
-            return;
+            return options;
         }
 
         for (auto i = 0; i < default_action_overrides.size(); i++)
@@ -503,7 +507,7 @@ void FilesystemConfiguration::_reload()
         if (!custom_actions.IsSequence())
         {
             mir::log_error("custom_actions: value must be an array");
-            return;
+            return options;
         }
 
         for (auto i = 0; i < custom_actions.size(); i++)
@@ -721,6 +725,25 @@ void FilesystemConfiguration::_reload()
         }
     }
 
+    // Focus
+    if (config["focus_mode"])
+    {
+        try
+        {
+            auto const mode = config["focus_mode"].as<std::string>();
+            if (mode == "structural")
+                options.focus_mode = FocusMode::structural;
+            else if (mode == "geometric")
+                options.focus_mode = FocusMode::geometric;
+            else
+                mir::log_error("focus_mode should be 'structural' or 'geometric': L%d:%d", config["focus_mode"].Mark().line, config["focus_mode"].Mark().column);
+        }
+        catch (YAML::BadConversion const& e)
+        {
+            mir::log_error("Unable to parse focus_mode: %s", e.msg.c_str());
+        }
+    }
+
     // Environment variables
     if (config["environment_variables"])
     {
@@ -805,10 +828,11 @@ void FilesystemConfiguration::_reload()
         }
     }
 
-    read_animation_definitions(config);
+    read_animation_definitions(config, options);
+    return options;
 }
 
-void FilesystemConfiguration::read_animation_definitions(YAML::Node const& root)
+void FilesystemConfiguration::read_animation_definitions(YAML::Node const& root, ConfigDetails& options)
 {
     if (root["animations"])
     {
@@ -869,27 +893,140 @@ void FilesystemConfiguration::_watch(miral::MirRunner& runner)
         return;
     }
 
-    inotify_fd = mir::Fd { inotify_init() };
-    file_watch = inotify_add_watch(inotify_fd, config_path.c_str(), IN_MODIFY);
+    // The directory is watched rather than the file, as editors that save by writing a
+    // temporary file and renaming it over the original would otherwise orphan the watch.
+    auto const config_file = std::filesystem::path(config_path);
+    config_filename = config_file.filename();
+    inotify_fd = mir::Fd { inotify_init1(IN_NONBLOCK | IN_CLOEXEC) };
+    file_watch = inotify_add_watch(inotify_fd, config_file.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
     if (file_watch < 0)
         mir::fatal_error("Unable to watch the config file");
 
+    debounce_fd = mir::Fd { timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC) };
+    reload_done_fd = mir::Fd { eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) };
+    if (debounce_fd < 0 || reload_done_fd < 0)
+        mir::fatal_error("Unable to create the file descriptors for reloading the config file");
+
     watch_handle = runner.register_fd_handler(inotify_fd, [&](int file_fd)
     {
-        union
+        alignas(inotify_event) char buffer[4096];
+        bool is_config_changed = false;
+        ssize_t length;
+        while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0)
         {
-            inotify_event event;
-            char buffer[sizeof(inotify_event) + NAME_MAX + 1];
-        } inotify_buffer;
+            for (char* ptr = buffer; ptr < buffer + length;)
+            {
+                auto const* event = reinterpret_cast<inotify_event const*>(ptr);
+                if (event->len > 0 && config_filename == event->name)
+                    is_config_changed = true;
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        if (!is_config_changed)
+            return;
+
+        // Each event restarts the timer, so a save made in several writes is parsed once
+        itimerspec const timeout {
+            .it_interval = { 0, 0 },
+            .it_value = { 0, reload_debounce_ms * 1000 * 1000 }
+        };
+        timerfd_settime(debounce_fd, 0, &timeout, nullptr);
+    });
 
-        if (read(inotify_fd, &inotify_buffer, sizeof(inotify_buffer)) < static_cast<ssize_t>(sizeof(inotify_event)))
+    debounce_handle = runner.register_fd_handler(debounce_fd, [&](int)
+    {
+        uint64_t expirations;
+        if (read(debounce_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+            return;
+
+        if (reload_thread.joinable())
+            is_reload_requested = true;
+        else
+            _start_reload();
+    });
+
+    reload_done_handle = runner.register_fd_handler(reload_done_fd, [&](int)
+    {
+        eventfd_t value;
+        if (eventfd_read(reload_done_fd, &value) < 0)
             return;
 
-        if (inotify_buffer.event.mask & (IN_MODIFY))
+        reload_thread.join();
+        std::optional<ConfigDetails> parsed;
         {
-            _reload();
+            std::lock_guard<std::mutex> lock(mutex);
+            parsed.swap(pending_details);
+        }
+
+        if (parsed)
+        {
+            _publish(parsed.value());
             has_changes = true;
         }
+
+        if (is_reload_requested)
+        {
+            is_reload_requested = false;
+            _start_reload();
+        }
+    });
+}
+
+ConfigDetails FilesystemConfiguration::_load() const
+{
+    if (!no_config)
+    {
+        if (auto cached = ConfigCache(config_path).load())
+        {
+            mir::log_info("Configuration was loaded from the cache");
+            return cached.value();
+        }
+    }
+
+    return _parse_and_cache();
+}
+
+ConfigDetails FilesystemConfiguration::_parse_and_cache() const
+{
+    if (no_config)
+        return _parse({});
+
+    // The file may be saved again while it is parsed, so the key is taken from the
+    // same bytes that are parsed rather than from the file as it is afterwards
+    ConfigCache const cache(config_path);
+    auto const source = cache.read();
+    if (!source)
+        throw YAML::BadFile(config_path);
+
+    auto options = _parse(source->contents);
+
+    // Whether the terminal exists may change without the file changing, so
+    // a configuration that could not find it is always parsed again
+    if (options.terminal || options.desired_terminal.empty())
+        cache.store(options, source.value());
+    return options;
+}
+
+void FilesystemConfiguration::_start_reload()
+{
+    reload_thread = std::thread([this]
+    {
+        std::optional<ConfigDetails> parsed;
+        try
+        {
+            parsed = _parse_and_cache();
+        }
+        catch (std::exception const& e)
+        {
+            mir::log_error("Unable to reload the configuration, the previous configuration is kept: %s", e.what());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending_details = std::move(parsed);
+        }
+        eventfd_write(reload_done_fd, 1);
     });
 }
 
@@ -900,15 +1037,26 @@ void FilesystemConfiguration::try_process_change()
         return;
 
     has_changes = false;
+    auto current = details.load();
+    ConfigChange const change {
+        .previous = last_notified,
+        .current = current,
+        .sections = get_changed_sections(*last_notified, *current)
+    };
+    last_notified = current;
+    if (change.sections == ConfigSection::none)
+        return;
+
     for (auto const& on_change : on_change_listeners)
     {
-        on_change.listener(*this);
+        if ((on_change.sections & change.sections) != ConfigSection::none)
+            on_change.listener(change);
     }
 }
 
 uint FilesystemConfiguration::get_primary_modifier() const
 {
-    return options.primary_modifier;
+    return details.load()->primary_modifier;
 }
 
 uint FilesystemConfiguration::parse_modifier(std::string const& stringified_action_key)
@@ -961,90 +1109,99 @@ std::string const& FilesystemConfiguration::get_filename() const
 
 MirInputEventModifier FilesystemConfiguration::get_input_event_modifier() const
 {
-    return (MirInputEventModifier)options.primary_modifier;
+    return (MirInputEventModifier)details.load()->primary_modifier;
 }
 
-CustomKeyCommand const*
+std::optional<CustomKeyCommand>
 FilesystemConfiguration::matches_custom_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers) const
 {
-    // TODO: Copy & paste
-    for (auto const& command : options.custom_key_commands)
-    {
-        if (action != command.action)
-            continue;
+    auto table = details.load()->key_bindings;
+    if (!table)
+        return std::nullopt;
 
-        auto command_modifiers = command.modifiers;
-        if (command_modifiers & miracle_input_event_modifier_default)
-            command_modifiers = command_modifiers & ~miracle_input_event_modifier_default | get_input_event_modifier();
+    auto entry = table->find(action, scan_code, modifiers);
+    if (!entry)
+        return std::nullopt;
 
-        if (command_modifiers != modifiers)
-            continue;
-
-        if (scan_code == command.key)
-            return &command;
-    }
-
-    return nullptr;
+    return entry->custom_command;
 }
 
 bool FilesystemConfiguration::matches_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers, std::function<bool(DefaultKeyCommand)> const& f) const
 {
-    for (int i = 0; i < DefaultKeyCommand::MAX; i++)
-    {
-        for (auto command : options.key_commands[i])
-        {
-            if (action != command.action)
-                continue;
-
-            auto command_modifiers = command.modifiers;
-            if (command_modifiers & miracle_input_event_modifier_default)
-                command_modifiers = command_modifiers & ~miracle_input_event_modifier_default | get_input_event_modifier();
+    auto table = details.load()->key_bindings;
+    if (!table)
+        return false;
 
-            if (command_modifiers != modifiers)
-                continue;
+    auto entry = table->find(action, scan_code, modifiers);
+    if (!entry)
+        return false;
 
-            if (scan_code == command.key)
-            {
-                if (f((DefaultKeyCommand)i))
-                    return true;
-            }
-        }
+    for (auto key_command : entry->default_commands)
+    {
+        if (f(key_command))
+            return true;
     }
 
     return false;
 }
 
+void FilesystemConfiguration::_publish(ConfigDetails const& options)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto next = std::make_shared<ConfigDetails>(options);
+
+    // If the user specified an --systemd-session-configure <APP_NAME>, let's add that to the list
+    if (systemd_app)
+        next->startup_apps.insert(next->startup_apps.begin(), systemd_app.value());
+
+    // If the user specified an --exec <APP_NAME>, let's add that to the list
+    if (exec_app)
+        next->startup_apps.push_back(exec_app.value());
+
+    next->key_bindings = std::make_shared<KeyBindingTable const>(
+        next->custom_key_commands,
+        next->key_commands,
+        next->primary_modifier);
+    details.store(std::move(next));
+}
+
 int FilesystemConfiguration::get_inner_gaps_x() const
 {
-    return options.inner_gaps_x;
+    return details.load()->inner_gaps_x;
 }
 
 int FilesystemConfiguration::get_inner_gaps_y() const
 {
-    return options.inner_gaps_y;
+    return details.load()->inner_gaps_y;
 }
 
 int FilesystemConfiguration::get_outer_gaps_x() const
 {
-    return options.outer_gaps_x;
+    return details.load()->outer_gaps_x;
 }
 
 int FilesystemConfiguration::get_outer_gaps_y() const
 {
-    return options.outer_gaps_y;
+    return details.load()->outer_gaps_y;
 }
 
-const std::vector<StartupApp>& FilesystemConfiguration::get_startup_apps() const
+std::vector<StartupApp> FilesystemConfiguration::get_startup_apps() const
 {
-    return options.startup_apps;
+    return details.load()->startup_apps;
 }
 
-int FilesystemConfiguration::register_listener(std::function<void(miracle::MiracleConfig&)> const& func)
+int FilesystemConfiguration::register_listener(std::function<void(ConfigChange const&)> const& func)
 {
     return register_listener(func, 5);
 }
 
-int FilesystemConfiguration::register_listener(std::function<void(miracle::MiracleConfig&)> const& func, int priority)
+int FilesystemConfiguration::register_listener(std::function<void(ConfigChange const&)> const& func, int priority)
+{
+    return register_listener(func, priority, ConfigSection::all);
+}
+
+int FilesystemConfiguration::register_listener(
+    std::function<void(ConfigChange const&)> const& func, int priority, ConfigSection sections)
 {
     int handle = next_listener_handle++;
 
@@ -1052,12 +1209,12 @@ int FilesystemConfiguration::register_listener(std::function<void(miracle::Mirac
     {
         if (it->priority >= priority)
         {
-            on_change_listeners.insert(it, { func, priority, handle });
+            on_change_listeners.insert(it, { func, priority, handle, sections });
             return handle;
         }
     }
 
-    on_change_listeners.push_back({ func, priority, handle });
+    on_change_listeners.push_back({ func, priority, handle, sections });
     return handle;
 }
 
@@ -1073,11 +1230,12 @@ void FilesystemConfiguration::unregister_listener(int handle)
     }
 }
 
-std::optional<std::string> const& FilesystemConfiguration::get_terminal_command() const
+std::optional<std::string> FilesystemConfiguration::get_terminal_command() const
 {
-    if (!options.terminal)
+    auto const snapshot = details.load();
+    if (!snapshot->terminal)
     {
-        auto error_string = "Terminal program does not exist " + options.desired_terminal;
+        auto error_string = "Terminal program does not exist " + snapshot->desired_terminal;
         mir::log_error("%s", error_string.c_str());
         NotifyNotification* n = notify_notification_new(
             "Terminal program does not exist",
@@ -1086,37 +1244,38 @@ std::optional<std::string> const& FilesystemConfiguration::get_terminal_command(
         notify_notification_set_timeout(n, 5000);
         notify_notification_show(n, nullptr);
     }
-    return options.terminal;
+    return snapshot->terminal;
 }
 
 int FilesystemConfiguration::get_resize_jump() const
 {
-    return options.resize_jump;
+    return details.load()->resize_jump;
 }
 
-std::vector<EnvironmentVariable> const& FilesystemConfiguration::get_env_variables() const
+std::vector<EnvironmentVariable> FilesystemConfiguration::get_env_variables() const
 {
-    return options.environment_variables;
+    return details.load()->environment_variables;
 }
 
-BorderConfig const& FilesystemConfiguration::get_border_config() const
+BorderConfig FilesystemConfiguration::get_border_config() const
 {
-    return options.border_config;
+    return details.load()->border_config;
 }
 
-std::array<AnimationDefinition, (int)AnimateableEvent::max> const& FilesystemConfiguration::get_animation_definitions() const
+std::array<AnimationDefinition, (int)AnimateableEvent::max> FilesystemConfiguration::get_animation_definitions() const
 {
-    return options.animation_defintions;
+    return details.load()->animation_defintions;
 }
 
 bool FilesystemConfiguration::are_animations_enabled() const
 {
-    return options.animations_enabled;
+    return details.load()->animations_enabled;
 }
 
 WorkspaceConfig FilesystemConfiguration::get_workspace_config(int key) const
 {
-    for (auto const& config : options.workspace_configs)
+    auto const snapshot = details.load();
+    for (auto const& config : snapshot->workspace_configs)
     {
         if (config.num == key)
             return config;
@@ -1130,7 +1289,47 @@ LayoutScheme FilesystemConfiguration::get_default_layout_scheme() const
     return LayoutScheme::horizontal;
 }
 
-FilesystemConfiguration::ConfigDetails::ConfigDetails()
+std::shared_ptr<ConfigDetails const> FilesystemConfiguration::snapshot() const
+{
+    return details.load();
+}
+
+ConfigSection miracle::get_changed_sections(ConfigDetails const& previous, ConfigDetails const& current)
+{
+    auto sections = ConfigSection::none;
+    auto const mark = [&](bool changed, ConfigSection section)
+    {
+        if (changed)
+            sections = sections | section;
+    };
+
+    mark(previous.primary_modifier != current.primary_modifier
+            || previous.custom_key_commands != current.custom_key_commands
+            || !std::equal(
+                std::begin(previous.key_commands),
+                std::end(previous.key_commands),
+                std::begin(current.key_commands)),
+        ConfigSection::key_bindings);
+    mark(previous.inner_gaps_x != current.inner_gaps_x
+            || previous.inner_gaps_y != current.inner_gaps_y
+            || previous.outer_gaps_x != current.outer_gaps_x
+            || previous.outer_gaps_y != current.outer_gaps_y,
+        ConfigSection::gaps);
+    mark(previous.border_config != current.border_config, ConfigSection::borders);
+    mark(previous.animations_enabled != current.animations_enabled
+            || previous.animation_defintions != current.animation_defintions,
+        ConfigSection::animations);
+    mark(previous.startup_apps != current.startup_apps, ConfigSection::startup_apps);
+    mark(previous.environment_variables != current.environment_variables, ConfigSection::environment);
+    mark(previous.terminal != current.terminal || previous.desired_terminal != current.desired_terminal,
+        ConfigSection::terminal);
+    mark(previous.resize_jump != current.resize_jump, ConfigSection::resize_jump);
+    mark(previous.workspace_configs != current.workspace_configs, ConfigSection::workspaces);
+    mark(previous.focus_mode != current.focus_mode, ConfigSection::focus);
+    return sections;
+}
+
+ConfigDetails::ConfigDetails()
 {
     const KeyCommand default_key_commands[DefaultKeyCommand::MAX] = {
         { MirKeyboardAction::mir_keyboard_action_down,
@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "container.h"
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <glm/glm.hpp>
 #include <linux/input.h>
@@ -31,6 +32,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace mir
@@ -51,6 +53,8 @@ class FdHandle;
 namespace miracle
 {
 
+class KeyBindingTable;
+
 enum DefaultKeyCommand
 {
     Terminal = 0,
@@ -99,16 +103,24 @@ enum DefaultKeyCommand
     MAX
 };
 
+/// Stands in for the primary modifier (the "action_key") in [KeyCommand::modifiers]
+/// until the binding is resolved against the configuration.
+uint const miracle_input_event_modifier_default = 1 << 18;
+
 struct KeyCommand
 {
     MirKeyboardAction action;
     uint modifiers;
     int key;
+
+    bool operator==(KeyCommand const&) const = default;
 };
 
 struct CustomKeyCommand : KeyCommand
 {
     std::string command;
+
+    bool operator==(CustomKeyCommand const&) const = default;
 };
 
 typedef std::vector<KeyCommand> KeyCommandList;
@@ -120,12 +132,16 @@ struct StartupApp
     bool no_startup_id = false;
     bool should_halt_compositor_on_death = false;
     bool in_systemd_scope = false;
+
+    bool operator==(StartupApp const&) const = default;
 };
 
 struct EnvironmentVariable
 {
     std::string key;
     std::string value;
+
+    bool operator==(EnvironmentVariable const&) const = default;
 };
 
 struct BorderConfig
@@ -133,12 +149,26 @@ struct BorderConfig
     int size = 0;
     glm::vec4 focus_color = glm::vec4(0);
     glm::vec4 color = glm::vec4(0);
+
+    bool operator==(BorderConfig const&) const = default;
 };
 
 struct WorkspaceConfig
 {
     int num = -1;
     ContainerType layout = ContainerType::leaf;
+
+    bool operator==(WorkspaceConfig const&) const = default;
+};
+
+/// How a window is chosen when focus moves in a direction.
+enum class FocusMode
+{
+    /// Moves to the neighbouring container in the tree, as i3 does.
+    structural,
+
+    /// Moves to the nearest window on screen, continuing onto neighbouring outputs.
+    geometric
 };
 
 enum class RenderFilter : int
@@ -150,6 +180,76 @@ enum class RenderFilter : int
     tritanopia
 };
 
+/// Everything that is read from the configuration file. Once published, a
+/// [ConfigDetails] is never modified: a reload builds a new one instead.
+struct ConfigDetails
+{
+    ConfigDetails();
+    uint primary_modifier = mir_input_event_modifier_meta;
+    std::vector<CustomKeyCommand> custom_key_commands;
+    KeyCommandList key_commands[DefaultKeyCommand::MAX];
+    int inner_gaps_x = 10;
+    int inner_gaps_y = 10;
+    int outer_gaps_x = 10;
+    int outer_gaps_y = 10;
+    std::vector<StartupApp> startup_apps;
+    std::optional<std::string> terminal = "miracle-wm-sensible-terminal";
+    std::string desired_terminal = "";
+    int resize_jump = 50;
+    FocusMode focus_mode = FocusMode::structural;
+    std::vector<EnvironmentVariable> environment_variables;
+    BorderConfig border_config;
+    bool animations_enabled = true;
+    std::array<AnimationDefinition, (int)AnimateableEvent::max> animation_defintions;
+    std::vector<WorkspaceConfig> workspace_configs;
+
+    /// Built from [custom_key_commands] and [key_commands] when the snapshot is published.
+    std::shared_ptr<KeyBindingTable const> key_bindings;
+};
+
+/// The sections of [ConfigDetails] that a listener may subscribe to. Values are bit flags.
+enum class ConfigSection : uint32_t
+{
+    none = 0,
+    key_bindings = 1 << 0,
+    gaps = 1 << 1,
+    borders = 1 << 2,
+    animations = 1 << 3,
+    startup_apps = 1 << 4,
+    environment = 1 << 5,
+    terminal = 1 << 6,
+    resize_jump = 1 << 7,
+    workspaces = 1 << 8,
+    focus = 1 << 9,
+    all = ~0u
+};
+
+inline ConfigSection operator|(ConfigSection left, ConfigSection right)
+{
+    return static_cast<ConfigSection>(static_cast<uint32_t>(left) | static_cast<uint32_t>(right));
+}
+
+inline ConfigSection operator&(ConfigSection left, ConfigSection right)
+{
+    return static_cast<ConfigSection>(static_cast<uint32_t>(left) & static_cast<uint32_t>(right));
+}
+
+/// Returns the sections that differ between [previous] and [current].
+ConfigSection get_changed_sections(ConfigDetails const& previous, ConfigDetails const& current);
+
+/// Handed to listeners when a new configuration has been published.
+struct ConfigChange
+{
+    std::shared_ptr<ConfigDetails const> previous;
+    std::shared_ptr<ConfigDetails const> current;
+    ConfigSection sections = ConfigSection::none;
+
+    [[nodiscard]] bool has_changed(ConfigSection section) const
+    {
+        return (sections & section) != ConfigSection::none;
+    }
+};
+
 class MiracleConfig
 {
 public:
@@ -157,26 +257,33 @@ public:
     virtual void load(mir::Server& server) = 0;
     [[nodiscard]] virtual std::string const& get_filename() const = 0;
     [[nodiscard]] virtual MirInputEventModifier get_input_event_modifier() const = 0;
-    [[nodiscard]] virtual CustomKeyCommand const* matches_custom_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers) const = 0;
+    [[nodiscard]] virtual std::optional<CustomKeyCommand> matches_custom_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers) const = 0;
     virtual bool matches_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers, std::function<bool(DefaultKeyCommand)> const& f) const = 0;
     [[nodiscard]] virtual int get_inner_gaps_x() const = 0;
     [[nodiscard]] virtual int get_inner_gaps_y() const = 0;
     [[nodiscard]] virtual int get_outer_gaps_x() const = 0;
     [[nodiscard]] virtual int get_outer_gaps_y() const = 0;
-    [[nodiscard]] virtual std::vector<StartupApp> const& get_startup_apps() const = 0;
-    [[nodiscard]] virtual std::optional<std::string> const& get_terminal_command() const = 0;
+    [[nodiscard]] virtual std::vector<StartupApp> get_startup_apps() const = 0;
+    [[nodiscard]] virtual std::optional<std::string> get_terminal_command() const = 0;
     [[nodiscard]] virtual int get_resize_jump() const = 0;
-    [[nodiscard]] virtual std::vector<EnvironmentVariable> const& get_env_variables() const = 0;
-    [[nodiscard]] virtual BorderConfig const& get_border_config() const = 0;
-    [[nodiscard]] virtual std::array<AnimationDefinition, (int)AnimateableEvent::max> const& get_animation_definitions() const = 0;
+    [[nodiscard]] virtual std::vector<EnvironmentVariable> get_env_variables() const = 0;
+    [[nodiscard]] virtual BorderConfig get_border_config() const = 0;
+    [[nodiscard]] virtual std::array<AnimationDefinition, (int)AnimateableEvent::max> get_animation_definitions() const = 0;
     [[nodiscard]] virtual bool are_animations_enabled() const = 0;
     [[nodiscard]] virtual WorkspaceConfig get_workspace_config(int key) const = 0;
     [[nodiscard]] virtual LayoutScheme get_default_layout_scheme() const = 0;
 
-    virtual int register_listener(std::function<void(miracle::MiracleConfig&)> const&) = 0;
+    /// Returns the current configuration. The snapshot never changes, so callers that
+    /// read several values should hold onto one snapshot rather than calling each getter.
+    [[nodiscard]] virtual std::shared_ptr<ConfigDetails const> snapshot() const = 0;
+
+    virtual int register_listener(std::function<void(ConfigChange const&)> const&) = 0;
     /// Register a listener on configuration change. A lower "priority" number signifies that the
     /// listener should be triggered earlier. A higher priority means later
-    virtual int register_listener(std::function<void(miracle::MiracleConfig&)> const&, int priority) = 0;
+    virtual int register_listener(std::function<void(ConfigChange const&)> const&, int priority) = 0;
+
+    /// Register a listener that is only triggered when one of the [sections] has changed.
+    virtual int register_listener(std::function<void(ConfigChange const&)> const&, int priority, ConfigSection sections) = 0;
     virtual void unregister_listener(int handle) = 0;
     virtual void try_process_change() = 0;
     virtual uint get_primary_modifier() const = 0;
@@ -187,30 +294,32 @@ class FilesystemConfiguration : public MiracleConfig
 public:
     explicit FilesystemConfiguration(miral::MirRunner&);
     FilesystemConfiguration(miral::MirRunner&, std::string const&, bool load_immediately = false);
-    ~FilesystemConfiguration() = default;
+    ~FilesystemConfiguration();
     FilesystemConfiguration(FilesystemConfiguration const&) = default;
     auto operator=(FilesystemConfiguration const&) -> FilesystemConfiguration& = default;
 
     void load(mir::Server& server) override;
     [[nodiscard]] std::string const& get_filename() const override;
     [[nodiscard]] MirInputEventModifier get_input_event_modifier() const override;
-    [[nodiscard]] CustomKeyCommand const* matches_custom_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers) const override;
+    [[nodiscard]] std::optional<CustomKeyCommand> matches_custom_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers) const override;
     bool matches_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers, std::function<bool(DefaultKeyCommand)> const& f) const override;
     [[nodiscard]] int get_inner_gaps_x() const override;
     [[nodiscard]] int get_inner_gaps_y() const override;
     [[nodiscard]] int get_outer_gaps_x() const override;
     [[nodiscard]] int get_outer_gaps_y() const override;
-    [[nodiscard]] std::vector<StartupApp> const& get_startup_apps() const override;
-    [[nodiscard]] std::optional<std::string> const& get_terminal_command() const override;
+    [[nodiscard]] std::vector<StartupApp> get_startup_apps() const override;
+    [[nodiscard]] std::optional<std::string> get_terminal_command() const override;
     [[nodiscard]] int get_resize_jump() const override;
-    [[nodiscard]] std::vector<EnvironmentVariable> const& get_env_variables() const override;
-    [[nodiscard]] BorderConfig const& get_border_config() const override;
-    [[nodiscard]] std::array<AnimationDefinition, (int)AnimateableEvent::max> const& get_animation_definitions() const override;
+    [[nodiscard]] std::vector<EnvironmentVariable> get_env_variables() const override;
+    [[nodiscard]] BorderConfig get_border_config() const override;
+    [[nodiscard]] std::array<AnimationDefinition, (int)AnimateableEvent::max> get_animation_definitions() const override;
     [[nodiscard]] bool are_animations_enabled() const override;
     [[nodiscard]] WorkspaceConfig get_workspace_config(int key) const override;
     [[nodiscard]] LayoutScheme get_default_layout_scheme() const override;
-    int register_listener(std::function<void(miracle::MiracleConfig&)> const&) override;
-    int register_listener(std::function<void(miracle::MiracleConfig&)> const&, int priority) override;
+    [[nodiscard]] std::shared_ptr<ConfigDetails const> snapshot() const override;
+    int register_listener(std::function<void(ConfigChange const&)> const&) override;
+    int register_listener(std::function<void(ConfigChange const&)> const&, int priority) override;
+    int register_listener(std::function<void(ConfigChange const&)> const&, int priority, ConfigSection sections) override;
     void unregister_listener(int handle) override;
     void try_process_change() override;
     [[nodiscard]] uint get_primary_modifier() const override;
@@ -218,16 +327,24 @@ public:
 private:
     struct ChangeListener
     {
-        std::function<void(miracle::MiracleConfig&)> listener;
+        std::function<void(ConfigChange const&)> listener;
         int priority;
         int handle;
+        ConfigSection sections;
     };
 
     static uint parse_modifier(std::string const& stringified_action_key);
     void _init(std::optional<StartupApp> const& systemd_app, std::optional<StartupApp> const& exec_app);
-    void _reload();
+    [[nodiscard]] ConfigDetails _parse(std::string const& contents) const;
+    [[nodiscard]] ConfigDetails _load() const;
+
+    /// Reads the configuration file once, parses it and caches the result under a key
+    /// taken from the contents that were parsed.
+    [[nodiscard]] ConfigDetails _parse_and_cache() const;
+    void _publish(ConfigDetails const&);
     void _watch(miral::MirRunner& runner);
-    void read_animation_definitions(YAML::Node const&);
+    void _start_reload();
+    static void read_animation_definitions(YAML::Node const&, ConfigDetails&);
 
     miral::MirRunner& runner;
     int next_listener_handle = 0;
@@ -238,33 +355,32 @@ private:
     mir::Fd inotify_fd;
     std::unique_ptr<miral::FdHandle> watch_handle;
     int file_watch = 0;
+    std::string config_filename;
+
+    /// Armed by each change to the file, so that a burst of writes causes one reload.
+    mir::Fd debounce_fd;
+    std::unique_ptr<miral::FdHandle> debounce_handle;
+
+    /// The file is parsed on [reload_thread]. Once it is done, [pending_details] is set
+    /// and [reload_done_fd] wakes the main loop, which publishes the result.
+    std::thread reload_thread;
+    mir::Fd reload_done_fd;
+    std::unique_ptr<miral::FdHandle> reload_done_handle;
+    std::optional<ConfigDetails> pending_details;
+    bool is_reload_requested = false;
     std::mutex mutex;
     std::atomic<bool> has_changes = false;
     bool is_loaded_ = false;
 
-    static const uint miracle_input_event_modifier_default = 1 << 18;
-    struct ConfigDetails
-    {
-        ConfigDetails();
-        uint primary_modifier = mir_input_event_modifier_meta;
-        std::vector<CustomKeyCommand> custom_key_commands;
-        KeyCommandList key_commands[DefaultKeyCommand::MAX];
-        int inner_gaps_x = 10;
-        int inner_gaps_y = 10;
-        int outer_gaps_x = 10;
-        int outer_gaps_y = 10;
-        std::vector<StartupApp> startup_apps;
-        std::optional<std::string> terminal = "miracle-wm-sensible-terminal";
-        std::string desired_terminal = "";
-        int resize_jump = 50;
-        std::vector<EnvironmentVariable> environment_variables;
-        BorderConfig border_config;
-        bool animations_enabled = true;
-        std::array<AnimationDefinition, (int)AnimateableEvent::max> animation_defintions;
-        std::vector<WorkspaceConfig> workspace_configs;
-    };
+    std::optional<StartupApp> systemd_app;
+    std::optional<StartupApp> exec_app;
+
+    /// The snapshot that every getter reads from. It is replaced as a whole
+    /// after each reload, so readers on any thread get a consistent view.
+    std::atomic<std::shared_ptr<ConfigDetails const>> details;
 
-    ConfigDetails options;
+    /// The snapshot that listeners were last notified with.
+    std::shared_ptr<ConfigDetails const> last_notified;
 };
 }
 
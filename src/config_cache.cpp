@@ -0,0 +1,421 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "config_cache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <mir/log.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+using namespace miracle;
+
+namespace
+{
+uint32_t const cache_magic = 0x4D57434Bu; // "MWCK"
+
+/// Bump whenever [ConfigDetails] or the layout below changes.
+uint32_t const cache_version = 2;
+
+uint64_t fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325ull)
+{
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/// A read-only mapping of a whole file.
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string const& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+        {
+            stat_ = st;
+            if (st.st_size > 0)
+            {
+                void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED)
+                {
+                    data_ = static_cast<char const*>(mapped);
+                    size_ = st.st_size;
+                }
+            }
+        }
+
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data_)
+            munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    [[nodiscard]] std::optional<struct stat> const& status() const { return stat_; }
+    [[nodiscard]] std::string_view view() const { return { data_ ? data_ : "", size_ }; }
+
+private:
+    std::optional<struct stat> stat_;
+    char const* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+using CacheKey = ConfigCache::Key;
+
+CacheKey make_cache_key(struct stat const& status, std::string_view contents)
+{
+    // The terminal is resolved against the PATH when the file is parsed
+    char const* path_env = getenv("PATH");
+    return CacheKey {
+        .mtime_ns = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec,
+        .size = static_cast<uint64_t>(status.st_size),
+        .content_hash = fnv1a(contents),
+        .environment_hash = fnv1a(path_env ? path_env : "")
+    };
+}
+
+class Writer
+{
+public:
+    template <typename T>
+    requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+    void field(T const& value)
+    {
+        buffer.append(reinterpret_cast<char const*>(&value), sizeof(T));
+    }
+
+    void field(bool const& value)
+    {
+        field(static_cast<uint8_t>(value));
+    }
+
+    void field(std::string const& value)
+    {
+        field(static_cast<uint32_t>(value.size()));
+        buffer.append(value);
+    }
+
+    void field(std::optional<std::string> const& value)
+    {
+        field(value.has_value());
+        if (value)
+            field(value.value());
+    }
+
+    template <typename T, typename F>
+    void sequence(std::vector<T> const& items, F const& f)
+    {
+        field(static_cast<uint32_t>(items.size()));
+        for (auto const& item : items)
+            f(item);
+    }
+
+    std::string buffer;
+};
+
+/// Reads back what [Writer] wrote. Reading past the end marks the reader as failed
+/// rather than throwing, and every later read is ignored.
+class Reader
+{
+public:
+    explicit Reader(std::string_view data) :
+        data { data }
+    {
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+    void field(T& value)
+    {
+        if (!take(sizeof(T)))
+            return;
+        memcpy(&value, data.data() + offset - sizeof(T), sizeof(T));
+    }
+
+    void field(bool& value)
+    {
+        uint8_t byte = 0;
+        field(byte);
+        value = byte != 0;
+    }
+
+    void field(std::string& value)
+    {
+        uint32_t size = 0;
+        field(size);
+        if (!take(size))
+            return;
+        value.assign(data.data() + offset - size, size);
+    }
+
+    void field(std::optional<std::string>& value)
+    {
+        bool has_value = false;
+        field(has_value);
+        if (!has_value)
+        {
+            value.reset();
+            return;
+        }
+
+        value.emplace();
+        field(value.value());
+    }
+
+    template <typename T, typename F>
+    void sequence(std::vector<T>& items, F const& f)
+    {
+        uint32_t count = 0;
+        field(count);
+
+        // Every item takes at least a byte, which bounds the allocation for a damaged file
+        if (count > remaining())
+            ok = false;
+        if (!ok)
+            return;
+
+        items.resize(count);
+        for (auto& item : items)
+            f(item);
+    }
+
+    [[nodiscard]] size_t remaining() const { return data.size() - offset; }
+    [[nodiscard]] std::string_view rest() const { return data.substr(offset); }
+
+    bool ok = true;
+
+private:
+    bool take(size_t size)
+    {
+        if (!ok || size > remaining())
+        {
+            ok = false;
+            return false;
+        }
+
+        offset += size;
+        return true;
+    }
+
+    std::string_view data;
+    size_t offset = 0;
+};
+
+template <typename Archive>
+void visit_fields(Archive& archive, CacheKey& key)
+{
+    archive.field(key.mtime_ns);
+    archive.field(key.size);
+    archive.field(key.content_hash);
+    archive.field(key.environment_hash);
+}
+
+template <typename Archive, typename Color>
+void visit_color(Archive& archive, Color& color)
+{
+    archive.field(color.r);
+    archive.field(color.g);
+    archive.field(color.b);
+    archive.field(color.a);
+}
+
+/// Lists every field of [ConfigDetails] once, for both writing and reading.
+/// [Details] is const when writing.
+template <typename Archive, typename Details>
+void visit_fields(Archive& archive, Details& details)
+{
+    auto const visit_key_command = [&](auto& command)
+    {
+        archive.field(command.action);
+        archive.field(command.modifiers);
+        archive.field(command.key);
+    };
+
+    archive.field(details.primary_modifier);
+    archive.sequence(details.custom_key_commands, [&](auto& command)
+    {
+        visit_key_command(command);
+        archive.field(command.command);
+    });
+    for (auto& key_commands : details.key_commands)
+        archive.sequence(key_commands, visit_key_command);
+
+    archive.field(details.inner_gaps_x);
+    archive.field(details.inner_gaps_y);
+    archive.field(details.outer_gaps_x);
+    archive.field(details.outer_gaps_y);
+    archive.sequence(details.startup_apps, [&](auto& app)
+    {
+        archive.field(app.command);
+        archive.field(app.restart_on_death);
+        archive.field(app.no_startup_id);
+        archive.field(app.should_halt_compositor_on_death);
+        archive.field(app.in_systemd_scope);
+    });
+    archive.field(details.terminal);
+    archive.field(details.desired_terminal);
+    archive.field(details.resize_jump);
+    archive.field(details.focus_mode);
+    archive.sequence(details.environment_variables, [&](auto& variable)
+    {
+        archive.field(variable.key);
+        archive.field(variable.value);
+    });
+
+    archive.field(details.border_config.size);
+    visit_color(archive, details.border_config.focus_color);
+    visit_color(archive, details.border_config.color);
+
+    archive.field(details.animations_enabled);
+    for (auto& definition : details.animation_defintions)
+    {
+        archive.field(definition.type);
+        archive.field(definition.function);
+        archive.field(definition.duration_seconds);
+        archive.field(definition.c1);
+        archive.field(definition.c2);
+        archive.field(definition.c3);
+        archive.field(definition.c4);
+        archive.field(definition.c5);
+        archive.field(definition.n1);
+        archive.field(definition.d1);
+    }
+
+    archive.sequence(details.workspace_configs, [&](auto& workspace)
+    {
+        archive.field(workspace.num);
+        archive.field(workspace.layout);
+    });
+}
+}
+
+ConfigCache::ConfigCache(std::string const& config_path) :
+    config_path { config_path },
+    cache_path { config_path + ".cache" }
+{
+}
+
+std::optional<ConfigCache::Source> ConfigCache::read() const
+{
+    MappedFile file(config_path);
+    if (!file.status())
+        return std::nullopt;
+
+    // The mapping reflects later writes to the file, so the key is taken from a copy
+    Source source { .contents = std::string(file.view()) };
+    source.key = make_cache_key(file.status().value(), source.contents);
+    return source;
+}
+
+std::optional<ConfigDetails> ConfigCache::load() const
+{
+    MappedFile config_file(config_path);
+    if (!config_file.status())
+        return std::nullopt;
+
+    auto const key = make_cache_key(config_file.status().value(), config_file.view());
+
+    MappedFile file(cache_path);
+    Reader reader(file.view());
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    CacheKey cached_key;
+    uint64_t body_hash = 0;
+    reader.field(magic);
+    reader.field(version);
+    visit_fields(reader, cached_key);
+    reader.field(body_hash);
+    if (!reader.ok || magic != cache_magic || version != cache_version)
+        return std::nullopt;
+
+    if (cached_key.mtime_ns != key.mtime_ns
+        || cached_key.size != key.size
+        || cached_key.content_hash != key.content_hash
+        || cached_key.environment_hash != key.environment_hash)
+        return std::nullopt;
+
+    if (fnv1a(reader.rest()) != body_hash)
+    {
+        mir::log_warning("ConfigCache: %s is damaged and will be rebuilt", cache_path.c_str());
+        return std::nullopt;
+    }
+
+    ConfigDetails details;
+    visit_fields(reader, details);
+    if (!reader.ok || reader.remaining() != 0)
+        return std::nullopt;
+
+    return details;
+}
+
+bool ConfigCache::store(ConfigDetails const& details, Source const& source) const
+{
+    auto key = source.key;
+    Writer body;
+    visit_fields(body, details);
+
+    Writer header;
+    header.field(cache_magic);
+    header.field(cache_version);
+    visit_fields(header, key);
+    header.field(fnv1a(body.buffer));
+
+    // Written to a temporary file first so that a reader never sees half of a cache
+    auto const temporary_path = cache_path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(header.buffer.data(), header.buffer.size());
+        file.write(body.buffer.data(), body.buffer.size());
+        if (!file)
+        {
+            mir::log_warning("ConfigCache: unable to write %s", temporary_path.c_str());
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary_path.c_str(), cache_path.c_str()) != 0)
+    {
+        mir::log_warning("ConfigCache: unable to replace %s", cache_path.c_str());
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+
+    return true;
+}
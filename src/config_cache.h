@@ -0,0 +1,77 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLEWM_CONFIG_CACHE_H
+#define MIRACLEWM_CONFIG_CACHE_H
+
+#include "config.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace miracle
+{
+
+/// Stores a resolved [ConfigDetails] in a binary file next to the configuration
+/// file, so that startup can skip parsing the YAML. The cache is keyed by the
+/// modification time, size and content hash of the configuration file, as well
+/// as by the PATH that was used to resolve the programs that it names. Any
+/// mismatch, or any damage to the cache file itself, makes it stale.
+class ConfigCache
+{
+public:
+    /// Identifies the configuration file, and the environment, that a cache was built from.
+    struct Key
+    {
+        int64_t mtime_ns = 0;
+        uint64_t size = 0;
+        uint64_t content_hash = 0;
+        uint64_t environment_hash = 0;
+    };
+
+    /// The contents of the configuration file, read once, and the key that they belong to.
+    struct Source
+    {
+        std::string contents;
+        Key key;
+    };
+
+    explicit ConfigCache(std::string const& config_path);
+
+    /// Returns the cached configuration, or nothing if the cache is missing or stale.
+    [[nodiscard]] std::optional<ConfigDetails> load() const;
+
+    /// Reads the configuration file. The details that are parsed from [Source::contents]
+    /// are stored under [Source::key], so a file that is saved again while it is being
+    /// parsed leaves the cache stale rather than wrong. Returns nothing if the file
+    /// cannot be read.
+    [[nodiscard]] std::optional<Source> read() const;
+
+    /// Writes [details], which were parsed from [source], as the cached configuration.
+    /// Returns false if the cache could not be written.
+    bool store(ConfigDetails const& details, Source const& source) const;
+
+    [[nodiscard]] std::string const& get_cache_path() const { return cache_path; }
+
+private:
+    std::string config_path;
+    std::string cache_path;
+};
+
+} // miracle
+
+#endif // MIRACLEWM_CONFIG_CACHE_H
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "container.h"
 #include "container_group_container.h"
+#include "container_snapshot.h"
 #include "floating_window_container.h"
 #include "layout_scheme.h"
 #include "leaf_container.h"
@@ -29,6 +30,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 using namespace miracle;
 
+namespace
+{
+std::atomic<uint64_t> structure_generation = 0;
+}
+
+std::pmr::memory_resource* miracle::get_container_resource()
+{
+    // Leaked on purpose: containers that are still referenced at exit must not
+    // return their memory to a pool that has already been destroyed
+    static auto* resource = new std::pmr::synchronized_pool_resource(
+        std::pmr::pool_options {
+            .max_blocks_per_chunk = 64,
+            .largest_required_pool_block = 2048 });
+    return resource;
+}
+
 ContainerType miracle::container_type_from_string(std::string const& str)
 {
     if (str == "tiled")
@@ -83,12 +100,12 @@ std::shared_ptr<ContainerGroupContainer> Container::as_group(std::shared_ptr<Con
 
 bool Container::is_leaf()
 {
-    return as_leaf(shared_from_this()) != nullptr;
+    return dynamic_cast<LeafContainer const*>(this) != nullptr;
 }
 
 bool Container::is_lane()
 {
-    return as_parent(shared_from_this()) != nullptr;
+    return dynamic_cast<ParentContainer const*>(this) != nullptr;
 }
 
 float Container::get_percent_of_parent() const
@@ -182,6 +199,16 @@ bool has_top_neighbor(Container const* container)
 }
 }
 
+uint64_t Container::get_structure_generation()
+{
+    return structure_generation.load(std::memory_order_relaxed);
+}
+
+void Container::advance_structure_generation()
+{
+    structure_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
 std::array<bool, (size_t)Direction::MAX> Container::get_neighbors() const
 {
     return {
@@ -191,3 +218,29 @@ std::array<bool, (size_t)Direction::MAX> Container::get_neighbors() const
         has_right_neighbor(this)
     };
 }
+
+void Container::snapshot(ContainerSnapshotBuffer& buffer) const
+{
+    append_snapshot(buffer);
+}
+
+size_t Container::append_snapshot(ContainerSnapshotBuffer& buffer) const
+{
+    auto const index = buffer.append();
+    auto& snapshot = buffer[index];
+    snapshot.id = reinterpret_cast<std::uintptr_t>(this);
+    snapshot.type = get_type();
+    snapshot.logical_area = get_logical_area();
+    snapshot.visible_area = get_visible_area();
+    snapshot.percent = get_percent_of_parent();
+    snapshot.focused = is_focused();
+    snapshot.fullscreen = is_fullscreen();
+
+    // A tree that is not yet attached to a workspace, such as in tests, is never visible
+    auto* workspace = get_workspace();
+    auto* output = workspace ? workspace->get_output() : nullptr;
+    snapshot.visible = output
+        && output->is_active()
+        && output->get_active_workspace_num() == workspace->get_workspace();
+    return index;
+}
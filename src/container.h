@@ -20,9 +20,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "direction.h"
 #include "layout_scheme.h"
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <glm/glm.hpp>
 #include <memory>
+#include <memory_resource>
 #include <mir/geometry/rectangle.h>
 #include <mir_toolkit/event.h>
 #include <miral/window.h>
@@ -42,6 +45,7 @@ class FloatingWindowContainer;
 class ContainerGroupContainer;
 class Workspace;
 class Output;
+class ContainerSnapshotBuffer;
 
 enum class ContainerType
 {
@@ -57,6 +61,22 @@ enum class ContainerType
 
 ContainerType container_type_from_string(std::string const& str);
 
+/// Returns the pool that every [Container] is allocated from. Containers are small,
+/// short-lived and walked together, so sharing a pool keeps them close in memory.
+/// The pool is thread safe, as the last reference to a container may be released
+/// from any thread.
+std::pmr::memory_resource* get_container_resource();
+
+/// Creates a container of type [T] in the [get_container_resource] pool. The control
+/// block is allocated alongside the container, as with [std::make_shared].
+template <typename T, typename... Args>
+std::shared_ptr<T> make_container(Args&&... args)
+{
+    return std::allocate_shared<T>(
+        std::pmr::polymorphic_allocator<T>(get_container_resource()),
+        std::forward<Args>(args)...);
+}
+
 /// Aligns with i3's concept of containers. A [Container] may map to
 /// an individual [miral::Window] or it may not. You can think of a [Container]
 /// as a logical rectangle on a [Workspace] upon which you can perform some
@@ -124,17 +144,36 @@ public:
     virtual LayoutScheme get_layout() const = 0;
     virtual nlohmann::json to_json() const = 0;
 
+    /// Appends a snapshot of this container, followed by those of its sub nodes, to [buffer].
+    virtual void snapshot(ContainerSnapshotBuffer& buffer) const;
+
     bool is_leaf();
     bool is_lane();
     [[nodiscard]] float get_percent_of_parent() const;
 
+    /// The position of this container among the sub nodes of its [ParentContainer],
+    /// or -1 if it has none. Kept up to date by the parent.
+    [[nodiscard]] int get_index_in_parent() const { return index_in_parent; }
+
     static std::shared_ptr<LeafContainer> as_leaf(std::shared_ptr<Container> const&);
     static std::shared_ptr<ParentContainer> as_parent(std::shared_ptr<Container> const&);
     static std::shared_ptr<FloatingWindowContainer> as_floating(std::shared_ptr<Container> const&);
     static std::shared_ptr<ContainerGroupContainer> as_group(std::shared_ptr<Container> const&);
 
+    /// Advanced whenever containers are added, removed, reparented or relaid out, so that
+    /// values derived from the shape of the tree can be cached against it.
+    [[nodiscard]] static uint64_t get_structure_generation();
+
 protected:
     [[nodiscard]] std::array<bool, (size_t)Direction::MAX> get_neighbors() const;
+    static void advance_structure_generation();
+
+    /// Appends a snapshot holding the state that every container shares and returns its index.
+    size_t append_snapshot(ContainerSnapshotBuffer& buffer) const;
+
+private:
+    friend class ParentContainer;
+    int index_in_parent = -1;
 };
 }
 
@@ -0,0 +1,114 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "container_snapshot.h"
+
+using namespace miracle;
+
+namespace
+{
+nlohmann::json rectangle_to_json(geom::Rectangle const& rectangle)
+{
+    return {
+        { "x",      rectangle.top_left.x.as_int()    },
+        { "y",      rectangle.top_left.y.as_int()    },
+        { "width",  rectangle.size.width.as_int()    },
+        { "height", rectangle.size.height.as_int()   },
+    };
+}
+
+bool holds_window(ContainerSnapshot const& snapshot)
+{
+    return snapshot.type == ContainerType::leaf || snapshot.type == ContainerType::floating_window;
+}
+}
+
+size_t ContainerSnapshotBuffer::append()
+{
+    if (count == items.size())
+        items.emplace_back();
+
+    // Assigning field by field, rather than from a fresh snapshot, keeps the capacity of the strings
+    auto& snapshot = items[count];
+    snapshot.id = 0;
+    snapshot.type = ContainerType::none;
+    snapshot.name.clear();
+    snapshot.app_id.clear();
+    snapshot.pid = 0;
+    snapshot.logical_area = {};
+    snapshot.visible_area = {};
+    snapshot.layout = LayoutScheme::none;
+    snapshot.percent = 0.f;
+    snapshot.border_width = 0;
+    snapshot.focused = false;
+    snapshot.visible = false;
+    snapshot.fullscreen = false;
+    snapshot.child_count = 0;
+    snapshot.descendant_count = 0;
+    return count++;
+}
+
+nlohmann::json miracle::to_json(std::span<ContainerSnapshot const> snapshots, size_t index)
+{
+    auto const& snapshot = snapshots[index];
+    auto const& area = snapshot.logical_area;
+    geom::Rectangle const decoration { geom::Point(0, 0), area.size };
+
+    nlohmann::json nodes = nlohmann::json::array();
+    for (size_t i = index + 1, end = index + 1 + snapshot.descendant_count; i < end; i += snapshots[i].descendant_count + 1)
+        nodes.push_back(to_json(snapshots, i));
+
+    nlohmann::json json = {
+        { "id",                   snapshot.id                                                                   },
+        { "name",                 snapshot.name                                                                 },
+        { "rect",                 rectangle_to_json(area)                                                       },
+        { "focused",              snapshot.focused                                                              },
+        { "focus",                std::vector<int>()                                                            },
+        { "border",               holds_window(snapshot) ? "normal" : "none"                                    },
+        { "current_border_width", snapshot.border_width                                                         },
+        { "layout",               snapshot.layout == LayoutScheme::none ? "none" : to_string(snapshot.layout)   },
+        { "orientation",          "none"                                                                        },
+        { "percent",              snapshot.percent                                                              },
+        { "window_rect",          rectangle_to_json(snapshot.visible_area)                                      },
+        { "deco_rect",            rectangle_to_json(decoration)                                                 },
+        { "geometry",             rectangle_to_json(decoration)                                                 },
+        { "window",               0                                                                             }, // TODO
+        { "urgent",               false                                                                         },
+        { "floating_nodes",       std::vector<int>()                                                            },
+        { "sticky",               false                                                                         },
+        { "type",                 snapshot.type == ContainerType::floating_window ? "floating_con" : "con"      },
+        { "fullscreen_mode",      snapshot.fullscreen ? 1 : 0                                                   }, // TODO: Support value 2
+        { "visible",              snapshot.visible                                                              },
+        { "shell",                "miracle-wm"                                                                  }, // TODO
+        { "inhibit_idle",         false                                                                         },
+        { "idle_inhibitors",      nlohmann::json::object()                                                      },
+        { "window_properties",    nlohmann::json::object()                                                      }, // TODO
+        { "nodes",                std::move(nodes)                                                              }
+    };
+
+    if (holds_window(snapshot))
+    {
+        json["pid"] = snapshot.pid;
+        json["app_id"] = snapshot.app_id;
+        json["idle_inhibitors"] = {
+            { "application", "none"    },
+            { "user",        "visible" },
+        };
+    }
+
+    return json;
+}
@@ -0,0 +1,92 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLEWM_CONTAINER_SNAPSHOT_H
+#define MIRACLEWM_CONTAINER_SNAPSHOT_H
+
+#include "container.h"
+#include "layout_scheme.h"
+#include <cstdint>
+#include <mir/geometry/rectangle.h>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace geom = mir::geometry;
+
+namespace miracle
+{
+
+/// A plain copy of the state of a single [Container]. The snapshots of a tree are
+/// stored in pre-order: each snapshot is followed by those of its sub nodes.
+struct ContainerSnapshot
+{
+    std::uintptr_t id = 0;
+    ContainerType type = ContainerType::none;
+    std::string name;
+
+    /// Empty, with a [pid] of 0, for containers that do not hold a window.
+    std::string app_id;
+    pid_t pid = 0;
+
+    geom::Rectangle logical_area;
+    geom::Rectangle visible_area;
+
+    /// [LayoutScheme::none] for containers that hold a window.
+    LayoutScheme layout = LayoutScheme::none;
+    float percent = 0.f;
+    int border_width = 0;
+    bool focused = false;
+    bool visible = false;
+    bool fullscreen = false;
+
+    /// The number of direct sub nodes.
+    uint32_t child_count = 0;
+
+    /// The number of snapshots that follow this one and belong to its subtree.
+    uint32_t descendant_count = 0;
+};
+
+/// Holds the snapshots of a tree. Clearing the buffer keeps its storage, including
+/// that of the strings, so a buffer that is reused for each walk stops allocating
+/// once it has grown to fit the tree.
+class ContainerSnapshotBuffer
+{
+public:
+    void clear() { count = 0; }
+
+    /// Adds a snapshot with every field reset and returns its index. Indices, rather
+    /// than references, stay valid as the buffer grows.
+    size_t append();
+
+    [[nodiscard]] ContainerSnapshot& operator[](size_t index) { return items[index]; }
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] std::span<ContainerSnapshot const> get() const { return { items.data(), count }; }
+
+private:
+    std::vector<ContainerSnapshot> items;
+    size_t count = 0;
+};
+
+/// Serializes the snapshot at [index] and its subtree in the format of an i3 tree reply.
+nlohmann::json to_json(std::span<ContainerSnapshot const> snapshots, size_t index = 0);
+
+} // miracle
+
+#endif // MIRACLEWM_CONTAINER_SNAPSHOT_H
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "floating_window_container.h"
 #include "compositor_state.h"
 #include "config.h"
+#include "container_snapshot.h"
 #include "leaf_container.h"
 #include "output.h"
 #include "workspace.h"
@@ -342,72 +343,22 @@ std::weak_ptr<ParentContainer> FloatingWindowContainer::get_parent() const
     return std::weak_ptr<ParentContainer>();
 }
 
-nlohmann::json FloatingWindowContainer::to_json() const
+void FloatingWindowContainer::snapshot(ContainerSnapshotBuffer& buffer) const
 {
+    auto const index = append_snapshot(buffer);
+    auto& snapshot = buffer[index];
     auto const app = window_.application();
-    auto const& win_info = window_controller.info_for(window_);
-    auto logical_area = get_logical_area();
-    auto visible_area = get_visible_area();
-    auto workspace = get_workspace();
-    auto output = get_output();
-    bool visible = true;
-
-    if (!output->is_active())
-        visible = false;
-
-    if (output->get_active_workspace_num() != workspace->get_workspace())
-        visible = false;
+    snapshot.name = app->name();
+    snapshot.app_id = window_controller.info_for(window_).application_id();
+    snapshot.pid = app->process_id();
+    snapshot.border_width = config->get_border_config().size;
+    snapshot.percent = 1.f;
+    snapshot.visible = is_pinned || snapshot.visible;
+}
 
-    return {
-        { "id",                   reinterpret_cast<std::uintptr_t>(this)                                                                                                                                                                                                    },
-        { "name",                 app->name()                                                                                                                                                                                                                               },
-        { "rect",                 {
-                      { "x", logical_area.top_left.x.as_int() },
-                      { "y", logical_area.top_left.y.as_int() },
-                      { "width", logical_area.size.width.as_int() },
-                      { "height", logical_area.size.height.as_int() },
-                  }                                                                                                                                                                                                                                        },
-        { "focused",              is_focused()                                                                                                                                                                                                                              },
-        { "focus",                std::vector<int>()                                                                                                                                                                                                                        },
-        { "border",               "normal"                                                                                                                                                                                                                                  },
-        { "current_border_width", config->get_border_config().size                                                                                                                                                                                                          },
-        { "layout",               "none"                                                                                                                                                                                                                                    },
-        { "orientation",          "none"                                                                                                                                                                                                                                    },
-        { "percent",              1.0                                                                                                                                                                                                                                       },
-        { "window_rect",          {
-                                                                                                                                                                                                                                                      { "x", visible_area.top_left.x.as_int() },
-                                                                                                                                                                                                                                                      { "y", visible_area.top_left.y.as_int() },
-                                                                                                                                                                                                                                                      { "width", visible_area.size.width.as_int() },
-                                                                                                                                                                                                                                                      { "height", visible_area.size.height.as_int() },
-                                                                                                                                                                                                                                                  } },
-        { "deco_rect",            {
-                           { "x", 0 },
-                           { "y", 0 },
-                           { "width", logical_area.size.width.as_int() },
-                           { "height", logical_area.size.height.as_int() },
-                       }                                                                                                                                                                                                                              },
-        { "geometry",             {
-                          { "x", 0 },
-                          { "y", 0 },
-                          { "width", logical_area.size.width.as_int() },
-                          { "height", logical_area.size.height.as_int() },
-                      }                                                                                                                                                                                                                                },
-        { "window",               0                                                                                                                                                                                                                                         }, // TODO
-        { "urgent",               false                                                                                                                                                                                                                                     },
-        { "floating_nodes",       std::vector<int>()                                                                                                                                                                                                                        },
-        { "sticky",               false                                                                                                                                                                                                                                     },
-        { "type",                 "floating_con"                                                                                                                                                                                                                            },
-        { "fullscreen_mode",      is_fullscreen() ? 1 : 0                                                                                                                                                                                                                   }, // TODO: Support value 2
-        { "pid",                  app->process_id()                                                                                                                                                                                                                         },
-        { "app_id",               win_info.application_id()                                                                                                                                                                                                                 },
-        { "visible",              is_pinned || visible                                                                                                                                                                                                                      },
-        { "shell",                "miracle-wm"                                                                                                                                                                                                                              }, // TODO
-        { "inhibit_idle",         false                                                                                                                                                                                                                                     },
-        { "idle_inhibitors",      {
-                                                            { "application", "none" },
-                                                            { "user", "visible" },
-                                                        }                                                                                                                                                                                       },
-        { "window_properties",    {}                                                                                                                                                                                                                                        }, // TODO
-        { "nodes",                std::vector<int>()                                                                                                                                                                                                                        }
-    };
-}
\ No newline at end of file
+nlohmann::json FloatingWindowContainer::to_json() const
+{
+    ContainerSnapshotBuffer buffer;
+    snapshot(buffer);
+    return miracle::to_json(buffer.get());
+}
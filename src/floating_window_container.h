@@ -89,6 +89,7 @@ public:
     LayoutScheme get_layout() const override { return LayoutScheme::none; }
     std::weak_ptr<ParentContainer> get_parent() const override;
     nlohmann::json to_json() const override;
+    void snapshot(ContainerSnapshotBuffer& buffer) const override;
 
 private:
     miral::Window window_;
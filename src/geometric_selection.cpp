@@ -0,0 +1,140 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "geometric_selection.h"
+#include "leaf_container.h"
+#include "parent_container.h"
+#include "tiling_window_tree.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace miracle;
+
+namespace
+{
+/// A rectangle as its edges, with the direction of travel rotated onto "right".
+/// [start] and [end] run along the direction of travel, [low] and [high] across it.
+struct Span
+{
+    int64_t start;
+    int64_t end;
+    int64_t low;
+    int64_t high;
+};
+
+Span to_span(geom::Rectangle const& rectangle, Direction direction)
+{
+    int64_t const left = rectangle.top_left.x.as_int();
+    int64_t const top = rectangle.top_left.y.as_int();
+    int64_t const right = left + rectangle.size.width.as_int();
+    int64_t const bottom = top + rectangle.size.height.as_int();
+
+    // Negating an axis turns a move towards lower coordinates into a move towards higher ones
+    switch (direction)
+    {
+    case Direction::left:
+        return { -right, -left, top, bottom };
+    case Direction::up:
+        return { -bottom, -top, left, right };
+    case Direction::down:
+        return { top, bottom, left, right };
+    case Direction::right:
+    default:
+        return { left, right, top, bottom };
+    }
+}
+
+/// Calls [f] with each leaf of [parent] that is on screen. Only the shown sub node
+/// of a tabbed or stacked parent is on screen.
+template <typename F>
+void for_each_shown_leaf(ParentContainer const& parent, F& f)
+{
+    auto const visit = [&](std::shared_ptr<Container> const& node)
+    {
+        if (auto const* leaf = dynamic_cast<LeafContainer const*>(node.get()))
+            f(*leaf);
+        else if (auto const* lane = dynamic_cast<ParentContainer const*>(node.get()))
+            for_each_shown_leaf(*lane, f);
+    };
+
+    auto const& sub_nodes = parent.get_sub_nodes();
+    if (sub_nodes.empty())
+        return;
+
+    if (parent.get_scheme() == LayoutScheme::tabbing || parent.get_scheme() == LayoutScheme::stacking)
+    {
+        auto shown = parent.get_focused_child();
+        visit(shown ? shown : sub_nodes.front());
+        return;
+    }
+
+    for (auto const& node : sub_nodes)
+        visit(node);
+}
+}
+
+std::optional<DirectionalDistance> miracle::measure_in_direction(
+    geom::Rectangle const& from,
+    geom::Rectangle const& candidate,
+    Direction direction)
+{
+    auto const origin = to_span(from, direction);
+    auto const target = to_span(candidate, direction);
+    if (target.start < origin.end)
+        return std::nullopt;
+
+    auto const overlap_low = std::max(origin.low, target.low);
+    auto const overlap_high = std::min(origin.high, target.high);
+    auto const offset = overlap_low < overlap_high ? 0 : overlap_low - overlap_high;
+    return DirectionalDistance {
+        // Spans that only touch at a corner share no length, so they are not aligned
+        .misaligned = overlap_low < overlap_high ? 0 : 1,
+        .distance = target.start - origin.end,
+        .offset = offset,
+        .center_offset = std::abs((target.low + target.high) - (origin.low + origin.high)) / 2
+    };
+}
+
+std::shared_ptr<LeafContainer> miracle::find_nearest_leaf(
+    TilingWindowTree const& tree,
+    geom::Rectangle const& from,
+    Direction direction,
+    Container const* exclude)
+{
+    LeafContainer const* nearest = nullptr;
+    DirectionalDistance nearest_distance;
+    auto const consider = [&](LeafContainer const& leaf)
+    {
+        if (&leaf == exclude)
+            return;
+
+        auto const distance = measure_in_direction(from, leaf.get_visible_area(), direction);
+        if (distance && (!nearest || distance.value() < nearest_distance))
+        {
+            nearest = &leaf;
+            nearest_distance = distance.value();
+        }
+    };
+
+    for_each_shown_leaf(*tree.get_root(), consider);
+    if (!nearest)
+        return nullptr;
+
+    return std::const_pointer_cast<LeafContainer>(
+        std::static_pointer_cast<LeafContainer const>(nearest->shared_from_this()));
+}
@@ -0,0 +1,71 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLEWM_GEOMETRIC_SELECTION_H
+#define MIRACLEWM_GEOMETRIC_SELECTION_H
+
+#include "direction.h"
+#include <compare>
+#include <cstdint>
+#include <memory>
+#include <mir/geometry/rectangle.h>
+#include <optional>
+
+namespace geom = mir::geometry;
+
+namespace miracle
+{
+class Container;
+class LeafContainer;
+class TilingWindowTree;
+
+/// How close a rectangle is to another in a particular direction. Lower is closer.
+struct DirectionalDistance
+{
+    /// Zero when the rectangles share a span across the direction of travel, such as
+    /// two windows side by side when moving left or right.
+    int misaligned = 0;
+
+    /// The gap between the near edge of the candidate and the far edge of the origin.
+    int64_t distance = 0;
+
+    /// The gap between the spans across the direction of travel, if they do not overlap.
+    int64_t offset = 0;
+
+    /// The distance between the centers across the direction of travel, to break ties.
+    int64_t center_offset = 0;
+
+    auto operator<=>(DirectionalDistance const&) const = default;
+};
+
+/// Measures [candidate] from [from] in [direction]. Returns nothing if [candidate] does
+/// not lie entirely beyond the edge of [from] that faces [direction].
+std::optional<DirectionalDistance> measure_in_direction(
+    geom::Rectangle const& from,
+    geom::Rectangle const& candidate,
+    Direction direction);
+
+/// Returns the visible leaf of [tree] that is nearest to [from] in [direction], ignoring
+/// [exclude]. Only the shown sub node of a tabbed or stacked parent is considered.
+std::shared_ptr<LeafContainer> find_nearest_leaf(
+    TilingWindowTree const& tree,
+    geom::Rectangle const& from,
+    Direction direction,
+    Container const* exclude = nullptr);
+}
+
+#endif // MIRACLEWM_GEOMETRIC_SELECTION_H
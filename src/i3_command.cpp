@@ -16,13 +16,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
 #include "i3_command.h"
+#include "container.h"
 #include "jpcre2.h"
-#include "string_extensions.h"
+#include "output.h"
 #include "window_controller.h"
 #include "window_helpers.h"
+#include "workspace.h"
 
+#include <charconv>
 #include <cstring>
-#include <ranges>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #define MIR_LOG_COMPONENT "miracle::i3_command"
 #include <mir/log.h>
 
@@ -41,6 +47,53 @@ const char* WORKSPACE_STRING = "workspace";
 const char* ALL_STRING = "all";
 const char* FLOATING_STRING = "floating";
 const char* TILING_STRING = "tiling";
+const char* APP_ID_STRING = "app_id";
+const char* CON_ID_STRING = "con_id";
+const char* CON_MARK_STRING = "con_mark";
+const char* FOCUSED_VALUE = "__focused__";
+
+/// The maximum number of compiled patterns that are kept around between calls.
+const size_t REGEX_CACHE_CAPACITY = 64;
+
+/// Least-recently-used cache of compiled patterns.
+class RegexCache
+{
+public:
+    std::shared_ptr<I3CompiledRegex> get(std::string const& pattern)
+    {
+        std::lock_guard lock(mutex);
+        auto it = lookup.find(pattern);
+        if (it != lookup.end())
+        {
+            // Move the entry to the front, as it is now the most recently used
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+
+        auto compiled = std::make_shared<I3CompiledRegex>(pattern);
+        entries.emplace_front(pattern, compiled);
+        lookup[entries.front().first] = entries.begin();
+        if (entries.size() > REGEX_CACHE_CAPACITY)
+        {
+            lookup.erase(entries.back().first);
+            entries.pop_back();
+        }
+
+        return compiled;
+    }
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<I3CompiledRegex>>;
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+    std::mutex mutex;
+};
+
+RegexCache& regex_cache()
+{
+    static RegexCache cache;
+    return cache;
+}
 
 inline bool try_parse_i3_scope(
     std::string_view const& view,
@@ -54,6 +107,9 @@ inline bool try_parse_i3_scope(
         return false;
 
     int possible_new_ptr = ptr + v_len;
+    if (possible_new_ptr >= static_cast<int>(view.size()))
+        return false;
+
     if (has_value)
     {
         if (view[possible_new_ptr] != '=')
@@ -64,7 +120,7 @@ inline bool try_parse_i3_scope(
     }
     else
     {
-        if (view[possible_new_ptr] == ']' || view[possible_new_ptr == ' '])
+        if (view[possible_new_ptr] == ']' || view[possible_new_ptr] == ' ')
         {
             ptr = possible_new_ptr;
             return true;
@@ -73,24 +129,101 @@ inline bool try_parse_i3_scope(
         return false;
     }
 }
+
+/// Resolves the value of a criteria into the form that is used when matching.
+void resolve_i3_scope_value(I3Scope& scope)
+{
+    auto const& value = scope.regex.value();
+    switch (scope.type)
+    {
+    case I3ScopeType::con_id:
+    {
+        if (value == FOCUSED_VALUE)
+        {
+            scope.matches_focused = true;
+            break;
+        }
+
+        std::uintptr_t id = 0;
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), id);
+        if (error != std::errc() || end != value.data() + value.size())
+            mir::log_error("Invalid con_id in criteria: %s", value.c_str());
+        else
+            scope.con_id = id;
+        break;
+    }
+    case I3ScopeType::workspace:
+        if (value == FOCUSED_VALUE)
+        {
+            scope.matches_focused = true;
+            break;
+        }
+        [[fallthrough]];
+    default:
+        scope.compiled_regex = I3CompiledRegex::get(value);
+        if (!scope.compiled_regex->is_valid())
+            mir::log_error("Invalid regex in criteria: %s", value.c_str());
+        break;
+    }
+}
+}
+
+struct I3CompiledRegex::Impl
+{
+    // Matching mutates the jpcre2 object, hence mutable. Criteria are only
+    // ever matched from the main loop.
+    mutable jpcre2::select<char>::Regex regex;
+};
+
+I3CompiledRegex::I3CompiledRegex(std::string const& pattern) :
+    impl { std::make_unique<Impl>() }
+{
+    impl->regex.compile(pattern, 0, jpcre2::JIT_COMPILE);
+}
+
+I3CompiledRegex::~I3CompiledRegex() = default;
+
+std::shared_ptr<I3CompiledRegex> I3CompiledRegex::get(std::string const& pattern)
+{
+    return regex_cache().get(pattern);
+}
+
+bool I3CompiledRegex::is_valid() const
+{
+    return !!impl->regex;
+}
+
+bool I3CompiledRegex::matches(std::string const& subject) const
+{
+    if (!is_valid())
+        return false;
+
+    return impl->regex.match(subject) > 0;
 }
 
 // https://i3wm.org/docs/userguide.html#command_criteria
 std::vector<I3Scope> I3Scope::parse(std::string_view const& view, int& ptr)
 {
-    if (view[0] != '[')
+    if (view.empty() || view[0] != '[')
     {
         ptr = 0;
         return {};
     }
 
     std::vector<I3Scope> result;
+    int const size = static_cast<int>(std::min<size_t>(view.size(), std::numeric_limits<int>::max()));
     ptr = 1; // Start past the opening bracket
 
-    while (view[ptr] != ']') // End when we encounter the closing bracket
+    while (ptr < size && view[ptr] != ']') // End when we encounter the closing bracket
     {
         I3Scope next;
-        if (try_parse_i3_scope(view, ptr, CLASS_STRING, true))
+        if (try_parse_i3_scope(view, ptr, APP_ID_STRING, true))
+            next.type = I3ScopeType::app_id;
+        else if (try_parse_i3_scope(view, ptr, CON_ID_STRING, true))
+            next.type = I3ScopeType::con_id;
+        else if (try_parse_i3_scope(view, ptr, CON_MARK_STRING, true))
+            next.type = I3ScopeType::con_mark;
+        else if (try_parse_i3_scope(view, ptr, CLASS_STRING, true))
             next.type = I3ScopeType::class_;
         else if (try_parse_i3_scope(view, ptr, WINDOW_ROLE_STRING, true))
             next.type = I3ScopeType::window_role;
@@ -132,40 +265,58 @@ std::vector<I3Scope> I3Scope::parse(std::string_view const& view, int& ptr)
 
         // If we get here, it is assumed that we need to also parse a regex
         ptr++;
-        if (view[ptr] != '"')
+        if (ptr >= size || view[ptr] != '"')
             continue;
 
         ptr++;
         auto start = ptr;
-        for (; ptr < view.size(); ptr++)
+        for (; ptr < size; ptr++)
         {
             if (view[ptr] == '"')
                 break;
         }
 
-        if (ptr == view.size())
-        {
-            // TODO: ERROR Haven't encountered a closing quote
+        if (ptr == size)
             break;
-        }
 
         ptr++;
         next.regex = view.substr(start, ptr - start - 1);
-
-        // TODO: Verify if we have a valid value here or not
+        resolve_i3_scope_value(next);
         result.push_back(next);
     }
 
+    if (ptr >= size)
+    {
+        mir::log_warning("I3Scope::parse: criteria is missing its closing bracket");
+        ptr = size;
+    }
+
     return result;
 }
 
+namespace
+{
+bool workspace_is_focused(Workspace* workspace)
+{
+    auto output = workspace->get_output();
+    return output && output->is_active() && output->get_active_workspace().get() == workspace;
+}
+
+std::string get_workspace_name(Workspace* workspace)
+{
+    if (!workspace->get_name().empty())
+        return workspace->get_name();
+    return std::to_string(workspace->get_workspace());
+}
+}
+
 bool I3ScopedCommandList::meets_criteria(miral::Window const& window, WindowController& window_controller) const
 {
-    typedef jpcre2::select<char> jp;
     auto container = window_controller.get_container(window);
     if (!container)
         return false;
 
+    // A window must satisfy every criteria in the scope
     for (auto const& criteria : scope)
     {
         switch (criteria.type)
@@ -175,13 +326,59 @@ bool I3ScopedCommandList::meets_criteria(miral::Window const& window, WindowCont
         case I3ScopeType::title:
         {
             auto& info = window_controller.info_for(window);
-            jp::Regex re(criteria.regex.value());
-            auto const& name = info.name();
-            return re.match(name);
+            if (!criteria.compiled_regex || !criteria.compiled_regex->matches(info.name()))
+                return false;
+            break;
         }
-        default:
+        case I3ScopeType::app_id:
+        {
+            auto& info = window_controller.info_for(window);
+            if (!criteria.compiled_regex || !criteria.compiled_regex->matches(info.application_id()))
+                return false;
+            break;
+        }
+        case I3ScopeType::con_id:
+        {
+            if (criteria.matches_focused)
+            {
+                if (!container->is_focused())
+                    return false;
+            }
+            else if (!criteria.con_id || reinterpret_cast<std::uintptr_t>(container.get()) != criteria.con_id.value())
+                return false;
+            break;
+        }
+        case I3ScopeType::con_mark:
+            // TODO: Containers cannot be marked yet, so nothing matches
+            return false;
+        case I3ScopeType::workspace:
+        {
+            auto workspace = container->get_workspace();
+            if (!workspace)
+                return false;
+
+            if (criteria.matches_focused)
+            {
+                if (!workspace_is_focused(workspace))
+                    return false;
+            }
+            else if (!criteria.compiled_regex || !criteria.compiled_regex->matches(get_workspace_name(workspace)))
+                return false;
             break;
         }
+        case I3ScopeType::floating:
+            if (container->get_type() != ContainerType::floating_window)
+                return false;
+            break;
+        case I3ScopeType::tiling:
+            if (container->get_type() != ContainerType::leaf)
+                return false;
+            break;
+        default:
+            // TODO: Criteria that are not supported yet, such as class or urgent, match
+            //  nothing, so that a scoped command never falls through to every window
+            return false;
+        }
     }
 
     return true;
@@ -189,106 +386,202 @@ bool I3ScopedCommandList::meets_criteria(miral::Window const& window, WindowCont
 
 namespace
 {
-bool equals(std::string_view const& s, const char* v)
+bool is_space(char c)
 {
-    // TODO: Perhaps this is a bit naive, as it is basically a "startswith"
-    return strncmp(s.data(), v, strlen(v)) == 0;
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/// Maps the first token of a command onto its type. Switching on the length
+/// first means that at most a handful of comparisons are made per command.
+I3CommandType get_command_type(std::string_view const& token)
+{
+    switch (token.size())
+    {
+    case 3:
+        if (token == "nop")
+            return I3CommandType::nop;
+        break;
+    case 4:
+        if (token == "exec")
+            return I3CommandType::exec;
+        if (token == "move")
+            return I3CommandType::move;
+        if (token == "swap")
+            return I3CommandType::swap;
+        if (token == "mark")
+            return I3CommandType::mark;
+        if (token == "exit")
+            return I3CommandType::exit;
+        if (token == "gaps")
+            return I3CommandType::gaps;
+        break;
+    case 5:
+        if (token == "split")
+            return I3CommandType::split;
+        if (token == "focus")
+            return I3CommandType::focus;
+        if (token == "input")
+            return I3CommandType::input;
+        break;
+    case 6:
+        if (token == "layout")
+            return I3CommandType::layout;
+        if (token == "sticky")
+            return I3CommandType::sticky;
+        if (token == "border")
+            return I3CommandType::border;
+        if (token == "reload")
+            return I3CommandType::reload;
+        if (token == "i3_bar")
+            return I3CommandType::i3_bar;
+        break;
+    case 7:
+        if (token == "shm_log")
+            return I3CommandType::shm_log;
+        if (token == "restart")
+            return I3CommandType::restart;
+        break;
+    case 9:
+        if (token == "workspace")
+            return I3CommandType::workspace;
+        if (token == "debug_log")
+            return I3CommandType::debug_log;
+        break;
+    case 10:
+        if (token == "scratchpad")
+            return I3CommandType::scratchpad;
+        break;
+    case 12:
+        if (token == "title_format")
+            return I3CommandType::title_format;
+        break;
+    case 17:
+        if (token == "title_window_icon")
+            return I3CommandType::title_window_icon;
+        break;
+    default:
+        break;
+    }
+
+    return I3CommandType::none;
 }
 }
 
 std::vector<I3ScopedCommandList> I3ScopedCommandList::parse(std::string_view const& view)
 {
+    // Every token is decoded into a single arena. A decoded token is never longer than
+    // its source, so reserving the size of the input up front guarantees that the arena
+    // does not reallocate and that the views handed out below remain valid.
+    auto arena = std::make_shared<std::string>();
+    arena->reserve(view.size());
+
     std::vector<I3ScopedCommandList> list;
+    I3ScopedCommandList current;
+    current.arena = arena;
+    I3Command command;
+    bool has_command = false;
+    bool is_parsing_options = true;
+    bool is_at_start_of_list = true;
+
+    auto const finish_command = [&]()
+    {
+        if (has_command)
+            current.commands.push_back(std::move(command));
+
+        command = {};
+        has_command = false;
+        is_parsing_options = true;
+    };
 
-    // First, split the view by semicolons, as that will denote different possible scopes
-    for (auto const& scope : ((view) | std::ranges::views::split(';')))
+    auto const finish_list = [&]()
     {
-        I3ScopedCommandList result;
+        finish_command();
+        if (!current.commands.empty())
+            list.push_back(std::move(current));
 
-        // Next, parse the scope
-        int ptr = 0;
-        auto sub_view = std::string_view(scope.data());
-        result.scope = I3Scope::parse(sub_view, ptr);
+        current = {};
+        current.arena = arena;
+        is_at_start_of_list = true;
+    };
 
-        // Next, split the sub_view by commas to get the list of commands with the scope
-        for (auto const& command_view : (std::string_view(&sub_view[ptr]) | std::ranges::views::split(',')))
+    size_t i = 0;
+    while (i < view.size())
+    {
+        char const c = view[i];
+        if (is_space(c))
         {
-            bool is_parsing_options = true;
-            I3Command next_command = { I3CommandType::none };
+            i++;
+            continue;
+        }
+
+        if (c == ';')
+        {
+            finish_list();
+            i++;
+            continue;
+        }
+
+        if (c == ',')
+        {
+            finish_command();
+            i++;
+            continue;
+        }
 
-            // Next, we can now read the command tokens space-by-space
-            for (auto const& command_token : ((trim_left(command_view)) | std::ranges::views::split(' ')))
+        if (c == '[' && is_at_start_of_list)
+        {
+            int ptr = 0;
+            current.scope = I3Scope::parse(view.substr(i), ptr);
+            i += ptr + 1; // Skip past the closing bracket
+            is_at_start_of_list = false;
+            continue;
+        }
+
+        is_at_start_of_list = false;
+
+        // Read the next token into the arena
+        auto const start = arena->size();
+        bool const is_quoted = c == '"' || c == '\'';
+        if (is_quoted)
+        {
+            // Within quotes, only the quote character and the backslash itself may be escaped
+            // so that regular expressions are passed through untouched
+            char const quote = c;
+            for (i++; i < view.size() && view[i] != quote; i++)
             {
-                if (next_command.type == I3CommandType::none)
-                {
-                    if (equals(command_token.data(), "exec"))
-                        next_command.type = I3CommandType::exec;
-                    else if (equals(command_token.data(), "split"))
-                        next_command.type = I3CommandType::split;
-                    else if (equals(command_token.data(), "layout"))
-                        next_command.type = I3CommandType::layout;
-                    else if (equals(command_token.data(), "focus"))
-                        next_command.type = I3CommandType::focus;
-                    else if (equals(command_token.data(), "move"))
-                        next_command.type = I3CommandType::move;
-                    else if (equals(command_token.data(), "swap"))
-                        next_command.type = I3CommandType::swap;
-                    else if (equals(command_token.data(), "sticky"))
-                        next_command.type = I3CommandType::sticky;
-                    else if (equals(command_token.data(), "workspace"))
-                        next_command.type = I3CommandType::workspace;
-                    else if (equals(command_token.data(), "mark"))
-                        next_command.type = I3CommandType::mark;
-                    else if (equals(command_token.data(), "title_format"))
-                        next_command.type = I3CommandType::title_format;
-                    else if (equals(command_token.data(), "title_window_icon"))
-                        next_command.type = I3CommandType::title_window_icon;
-                    else if (equals(command_token.data(), "border"))
-                        next_command.type = I3CommandType::border;
-                    else if (equals(command_token.data(), "shm_log"))
-                        next_command.type = I3CommandType::shm_log;
-                    else if (equals(command_token.data(), "debug_log"))
-                        next_command.type = I3CommandType::debug_log;
-                    else if (equals(command_token.data(), "restart"))
-                        next_command.type = I3CommandType::restart;
-                    else if (equals(command_token.data(), "reload"))
-                        next_command.type = I3CommandType::reload;
-                    else if (equals(command_token.data(), "exit"))
-                        next_command.type = I3CommandType::exit;
-                    else if (equals(command_token.data(), "scratchpad"))
-                        next_command.type = I3CommandType::scratchpad;
-                    else if (equals(command_token.data(), "nop"))
-                        next_command.type = I3CommandType::nop;
-                    else if (equals(command_token.data(), "i3_bar"))
-                        next_command.type = I3CommandType::i3_bar;
-                    else if (equals(command_token.data(), "gaps"))
-                        next_command.type = I3CommandType::gaps;
-                    else if (equals(command_token.data(), "input"))
-                        next_command.type = I3CommandType::input;
-                    else
-                    {
-                        mir::log_error("Invalid i3 command type: %s", command_token.data());
-                        continue;
-                    }
-                }
-                else
-                {
-                    auto s = std::string(command_token.data(), command_token.size());
-                    if (s.starts_with("--") && is_parsing_options)
-                        next_command.options.emplace_back(s);
-                    else
-                    {
-                        next_command.arguments.emplace_back(s);
-                        is_parsing_options = false;
-                    }
-                }
+                if (view[i] == '\\' && i + 1 < view.size() && (view[i + 1] == quote || view[i + 1] == '\\'))
+                    i++;
+                arena->push_back(view[i]);
             }
 
-            result.commands.push_back(next_command);
+            if (i == view.size())
+                mir::log_warning("I3ScopedCommandList::parse: unterminated quote in command");
+            else
+                i++; // Skip past the closing quote
+        }
+        else
+        {
+            for (; i < view.size() && !is_space(view[i]) && view[i] != ',' && view[i] != ';'; i++)
+                arena->push_back(view[i]);
         }
 
-        list.push_back(result);
+        std::string_view const token(arena->data() + start, arena->size() - start);
+        if (!has_command)
+        {
+            has_command = true;
+            command.type = get_command_type(token);
+            if (command.type == I3CommandType::none)
+                mir::log_error("Invalid i3 command type: %.*s", static_cast<int>(token.size()), token.data());
+        }
+        else if (!is_quoted && is_parsing_options && token.starts_with("--"))
+            command.options.push_back(token);
+        else
+        {
+            command.arguments.push_back(token);
+            is_parsing_options = false;
+        }
     }
 
+    finish_list();
     return list;
 }
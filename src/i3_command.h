@@ -18,10 +18,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIRACLEWM_I3_COMMAND_H
 #define MIRACLEWM_I3_COMMAND_H
 
+#include <cstdint>
+#include <memory>
 #include <miral/window.h>
 #include <miral/window_manager_tools.h>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace miracle
@@ -69,6 +72,7 @@ enum class I3ScopeType
     floating_from,
     tiling,
     tiling_from,
+    app_id,
 
     /// TODO: X11-only
     class_,
@@ -82,21 +86,54 @@ enum class I3ScopeType
     id,
 };
 
+/// A regular expression that is compiled (and JIT compiled, when available)
+/// once so that it can be matched against many windows.
+class I3CompiledRegex
+{
+public:
+    explicit I3CompiledRegex(std::string const& pattern);
+    ~I3CompiledRegex();
+
+    /// Returns the compiled form of [pattern]. The most recently used patterns
+    /// are cached, so scripts that repeat the same criteria only compile them once.
+    static std::shared_ptr<I3CompiledRegex> get(std::string const& pattern);
+
+    [[nodiscard]] bool is_valid() const;
+    [[nodiscard]] bool matches(std::string const& subject) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
 struct I3Scope
 {
     I3ScopeType type = I3ScopeType::none;
     std::optional<std::string> regex;
 
-    /// Assumes that the provided string_view is in [] brackets
+    /// The compiled form of [regex] for criteria that match against a string.
+    std::shared_ptr<I3CompiledRegex> compiled_regex;
+
+    /// The container id for con_id criteria.
+    std::optional<std::uintptr_t> con_id;
+
+    /// Set when the value is "__focused__", meaning that the criteria
+    /// refers to whatever is focused at the time that it is matched.
+    bool matches_focused = false;
+
+    /// Parses the criteria at the start of the view, which must begin with '['. On return,
+    /// [ptr] is on the closing bracket, or at the end of the view when there is none.
     static std::vector<I3Scope> parse(std::string_view const&, int& ptr);
 };
 
+/// A single command. The arguments and options are views into the
+/// [I3ScopedCommandList::arena] of the list that the command belongs to.
 struct I3Command
 {
     I3CommandType type = I3CommandType::none;
-    std::vector<std::string> arguments;
+    std::vector<std::string_view> arguments;
     /// Anything in the command that starts with "--"
-    std::vector<std::string> options;
+    std::vector<std::string_view> options;
 };
 
 struct I3ScopedCommandList
@@ -104,6 +141,10 @@ struct I3ScopedCommandList
     std::vector<I3Command> commands;
     std::vector<I3Scope> scope;
 
+    /// The decoded text of every argument and option. It is shared by all of the
+    /// lists that were parsed from the same input and is never modified afterwards.
+    std::shared_ptr<std::string const> arena;
+
     bool meets_criteria(miral::Window const&, WindowController&) const;
 
     static std::vector<I3ScopedCommandList> parse(std::string_view const&);
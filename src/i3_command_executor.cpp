@@ -19,12 +19,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "auto_restarting_launcher.h"
 #include "direction.h"
 #include "i3_command.h"
+#include "layout_transaction.h"
 #include "leaf_container.h"
 #include "parent_container.h"
 #include "policy.h"
 #include "utility_general.h"
 #include "window_controller.h"
 #include "window_helpers.h"
+#include "window_index.h"
 
 #define MIR_LOG_COMPONENT "miracle"
 #include <mir/log.h>
@@ -37,79 +39,155 @@ I3CommandExecutor::I3CommandExecutor(
     WorkspaceManager& workspace_manager,
     miral::WindowManagerTools const& tools,
     AutoRestartingLauncher& launcher,
-    WindowController& window_controller) :
+    WindowController& window_controller,
+    WindowIndex const& window_index) :
     policy { policy },
     workspace_manager { workspace_manager },
     tools { tools },
     launcher { launcher },
-    window_controller { window_controller }
+    window_controller { window_controller },
+    window_index { window_index }
 {
 }
 
-void I3CommandExecutor::process(miracle::I3ScopedCommandList const& command_list)
+namespace
 {
-    for (auto const& command : command_list.commands)
+/// Whether a scoped command of [type] is applied to each matching window in turn.
+/// Others act on the compositor as a whole, or, like focus, pick one window.
+bool applies_to_each_window(I3CommandType type)
+{
+    switch (type)
     {
-        switch (command.type)
-        {
-        case I3CommandType::exec:
-            process_exec(command, command_list);
-            break;
-        case I3CommandType::split:
-            process_split(command, command_list);
-            break;
-        case I3CommandType::focus:
-            process_focus(command, command_list);
-            break;
-        case I3CommandType::move:
-            process_move(command, command_list);
-            break;
-        case I3CommandType::sticky:
-            process_sticky(command, command_list);
-            break;
-        case I3CommandType::exit:
-            policy.quit();
-            break;
-        case I3CommandType::input:
-            process_input(command, command_list);
-            break;
-        case I3CommandType::workspace:
-            process_workspace(command, command_list);
-            break;
-        case I3CommandType::layout:
-            process_layout(command, command_list);
-            break;
-        default:
-            break;
-        }
+    case I3CommandType::split:
+    case I3CommandType::layout:
+    case I3CommandType::move:
+    case I3CommandType::sticky:
+        return true;
+    default:
+        return false;
     }
 }
+}
 
-miral::Window I3CommandExecutor::get_window_meeting_criteria(I3ScopedCommandList const& command_list)
+std::vector<I3CommandResult> I3CommandExecutor::process(miracle::I3ScopedCommandList const& command_list)
 {
-    miral::Window result;
-    tools.find_application([&](miral::ApplicationInfo const& info)
+    LayoutTransaction transaction;
+    std::vector<I3CommandResult> results;
+    results.reserve(command_list.commands.size());
+
+    // As in i3, the criteria are resolved once, before any of the commands run
+    std::vector<miral::Window> matches;
+    if (!command_list.scope.empty())
+        matches = get_windows_meeting_criteria(command_list);
+
+    for (auto const& command : command_list.commands)
     {
-        for (auto const& window : info.windows())
+        if (command_list.scope.empty() || !applies_to_each_window(command.type))
         {
-            if (command_list.meets_criteria(window, window_controller))
+            results.push_back(process_command(command, command_list));
+            continue;
+        }
+
+        if (matches.empty())
+        {
+            results.push_back({ false, "No window matches the criteria" });
+            continue;
+        }
+
+        // Policy acts on the active window, so each match is focused while the command
+        // is applied to it. Focus then returns to the window that held it before.
+        auto const previous = tools.active_window();
+        I3CommandResult result { true, {} };
+        for (auto const& window : matches)
+        {
+            if (!window_index.find(window))
+                continue;
+
+            // A window that cannot take focus, such as one on a hidden workspace, is
+            // reported as a failure rather than letting the command act on another window
+            window_controller.select_active_window(window);
+            if (tools.active_window() != window)
             {
-                result = window;
-                return true;
+                result = { false, "Unable to select a window that matches the criteria" };
+                continue;
             }
+
+            auto window_result = process_command(command, command_list);
+            if (!window_result.success)
+                result = std::move(window_result);
         }
 
-        return false;
+        if (previous && window_index.find(previous) && tools.active_window() != previous)
+            window_controller.select_active_window(previous);
+
+        results.push_back(std::move(result));
+    }
+
+    return results;
+}
+
+I3CommandResult I3CommandExecutor::process_command(I3Command const& command, I3ScopedCommandList const& command_list)
+{
+    bool success = false;
+    switch (command.type)
+    {
+    case I3CommandType::exec:
+        success = process_exec(command, command_list);
+        break;
+    case I3CommandType::split:
+        success = process_split(command, command_list);
+        break;
+    case I3CommandType::focus:
+        success = process_focus(command, command_list);
+        break;
+    case I3CommandType::move:
+        success = process_move(command, command_list);
+        break;
+    case I3CommandType::sticky:
+        success = process_sticky(command, command_list);
+        break;
+    case I3CommandType::exit:
+        success = policy.quit();
+        break;
+    case I3CommandType::input:
+        success = process_input(command, command_list);
+        break;
+    case I3CommandType::workspace:
+        success = process_workspace(command, command_list);
+        break;
+    case I3CommandType::layout:
+        success = process_layout(command, command_list);
+        break;
+    default:
+        mir::log_warning("process: unsupported command type: %d", (int)command.type);
+        return { false, "Unsupported command" };
+    }
+
+    if (success)
+        return { true, {} };
+    else
+        return { false, "Unable to process command" };
+}
+
+std::vector<miral::Window> I3CommandExecutor::get_windows_meeting_criteria(I3ScopedCommandList const& command_list)
+{
+    // The index narrows the scope down to a handful of candidates, which
+    // are then checked against the full criteria
+    auto windows = window_index.find_candidates(command_list.scope);
+    std::erase_if(windows, [&](miral::Window const& window)
+    {
+        return !command_list.meets_criteria(window, window_controller);
     });
-    return result;
+    window_index.sort_by_focus(windows);
+    return windows;
 }
 
-void I3CommandExecutor::process_exec(miracle::I3Command const& command, miracle::I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_exec(miracle::I3Command const& command, miracle::I3ScopedCommandList const& command_list)
 {
     if (command.arguments.empty())
     {
         mir::log_warning("process_exec: no arguments were supplied");
-        return;
+        return false;
     }
 
     bool no_startup_id = false;
@@ -119,47 +197,41 @@ void I3CommandExecutor::process_exec(miracle::I3Command const& command, miracle:
     if (command.arguments.empty())
     {
         mir::log_warning("process_exec: argument does not have a command to run");
-        return;
+        return false;
     }
 
     std::string exec_cmd;
     for (auto const& arg : command.arguments)
     {
-        exec_cmd += arg + " ";
+        exec_cmd.append(arg);
+        exec_cmd.push_back(' ');
     }
 
     StartupApp app { exec_cmd, false, no_startup_id };
     launcher.launch(app);
+    return true;
 }
 
-void I3CommandExecutor::process_split(miracle::I3Command const& command, miracle::I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_split(miracle::I3Command const& command, miracle::I3ScopedCommandList const& command_list)
 {
     if (command.arguments.empty())
     {
         mir::log_warning("process_split: no arguments were supplied");
-        return;
+        return false;
     }
 
     if (command.arguments.front() == "vertical")
-    {
-        policy.try_request_vertical();
-    }
+        return policy.try_request_vertical();
     else if (command.arguments.front() == "horizontal")
-    {
-        policy.try_request_horizontal();
-    }
+        return policy.try_request_horizontal();
     else if (command.arguments.front() == "toggle")
-    {
-        policy.try_toggle_layout(false);
-    }
-    else
-    {
-        mir::log_warning("process_split: unknown argument %s", command.arguments.front().c_str());
-        return;
-    }
+        return policy.try_toggle_layout(false);
+
+    mir::log_warning("process_split: unknown argument %s", std::string(command.arguments.front()).c_str());
+    return false;
 }
 
-void I3CommandExecutor::process_focus(I3Command const& command, I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_focus(I3Command const& command, I3ScopedCommandList const& command_list)
 {
     // https://i3wm.org/docs/userguide.html#_focusing_moving_containers
     if (command.arguments.empty())
@@ -167,14 +239,16 @@ void I3CommandExecutor::process_focus(I3Command const& command, I3ScopedCommandL
         if (command_list.scope.empty())
         {
             mir::log_warning("Focus command expected scope but none was provided");
-            return;
+            return false;
         }
 
-        auto window = get_window_meeting_criteria(command_list);
-        if (window)
-            window_controller.select_active_window(window);
+        // Only one window can hold focus, so the most recently focused match wins
+        auto windows = get_windows_meeting_criteria(command_list);
+        if (windows.empty())
+            return false;
 
-        return;
+        window_controller.select_active_window(windows.front());
+        return true;
     }
 
     auto const& arg = command.arguments.front();
@@ -183,49 +257,60 @@ void I3CommandExecutor::process_focus(I3Command const& command, I3ScopedCommandL
         if (command_list.scope.empty())
         {
             mir::log_warning("Focus 'workspace' command expected scope but none was provided");
-            return;
+            return false;
         }
 
-        auto window = get_window_meeting_criteria(command_list);
-        auto container = window_controller.get_container(window);
-        if (container)
-            workspace_manager.request_focus(container->get_workspace()->get_workspace());
+        auto windows = get_windows_meeting_criteria(command_list);
+        if (windows.empty())
+            return false;
+
+        auto container = window_controller.get_container(windows.front());
+        if (!container || !container->get_workspace())
+            return false;
+
+        return workspace_manager.request_focus(container->get_workspace()->get_workspace()) != nullptr;
     }
     else if (arg == "left")
-        policy.try_select(Direction::left);
+        return policy.try_select(Direction::left);
     else if (arg == "right")
-        policy.try_select(Direction::right);
+        return policy.try_select(Direction::right);
     else if (arg == "up")
-        policy.try_select(Direction::up);
+        return policy.try_select(Direction::up);
     else if (arg == "down")
-        policy.try_select(Direction::down);
+        return policy.try_select(Direction::down);
     else if (arg == "parent")
+    {
         mir::log_warning("'focus parent' is not supported, see https://github.com/mattkae/miracle-wm/issues/117"); // TODO
+        return false;
+    }
     else if (arg == "child")
+    {
         mir::log_warning("'focus child' is not supported, see https://github.com/mattkae/miracle-wm/issues/117"); // TODO
+        return false;
+    }
     else if (arg == "prev")
     {
         auto active_window = tools.active_window();
         if (!active_window)
-            return;
+            return false;
 
         auto container = window_controller.get_container(active_window);
         if (!container)
-            return;
+            return false;
 
         if (container->get_type() != ContainerType::leaf)
         {
             mir::log_warning("Cannot focus prev when a tiling window is not selected");
-            return;
+            return false;
         }
 
         if (auto parent = Container::as_parent(container->get_parent().lock()))
         {
-            auto index = parent->get_index_of_node(container);
-            if (index != 0)
+            auto index = container->get_index_in_parent();
+            if (index > 0)
             {
-                auto node_to_select = parent->get_nth_window(index - 1);
-                window_controller.select_active_window(node_to_select->window().value());
+                if (auto node_to_select = parent->get_nth_window(index - 1))
+                    window_controller.select_active_window(node_to_select->window().value());
             }
         }
     }
@@ -233,83 +318,99 @@ void I3CommandExecutor::process_focus(I3Command const& command, I3ScopedCommandL
     {
         auto active_window = tools.active_window();
         if (!active_window)
-            return;
+            return false;
 
         auto container = window_controller.get_container(active_window);
         if (!container)
-            return;
+            return false;
 
         if (container->get_type() != ContainerType::leaf)
         {
             mir::log_warning("Cannot focus prev when a tiling window is not selected");
-            return;
+            return false;
         }
 
         if (auto parent = Container::as_parent(container->get_parent().lock()))
         {
-            auto index = parent->get_index_of_node(container);
-            if (index != parent->num_nodes() - 1)
+            auto index = container->get_index_in_parent();
+            if (index >= 0 && index + 1 < (int)parent->num_nodes())
             {
-                auto node_to_select = parent->get_nth_window(index + 1);
-                window_controller.select_active_window(node_to_select->window().value());
+                if (auto node_to_select = parent->get_nth_window(index + 1))
+                    window_controller.select_active_window(node_to_select->window().value());
             }
         }
     }
     else if (arg == "floating")
+    {
         mir::log_warning("'focus floating' is not supported, see https://github.com/mattkae/miracle-wm/issues/117"); // TODO
+        return false;
+    }
     else if (arg == "tiling")
+    {
         mir::log_warning("'focus tiling' is not supported, see https://github.com/mattkae/miracle-wm/issues/117"); // TODO
+        return false;
+    }
     else if (arg == "mode_toggle")
+    {
         mir::log_warning("'focus mode_toggle' is not supported, see https://github.com/mattkae/miracle-wm/issues/117"); // TODO
+        return false;
+    }
     else if (arg == "output")
+    {
         mir::log_warning("'focus output' is not supported, see https://github.com/canonical/mir/issues/3357"); // TODO
+        return false;
+    }
+    else
+    {
+        mir::log_warning("process_focus: unknown argument %s", std::string(arg).c_str());
+        return false;
+    }
+
+    return true;
 }
 
 namespace
 {
-bool parse_move_distance(std::vector<std::string> const& arguments, int& index, int total_size, int& out)
+bool parse_move_distance(std::vector<std::string_view> const& arguments, int& index, int total_size, int& out)
 {
     auto size = arguments.size() - index;
     if (size <= 1)
         return false;
 
-    try
+    if (!try_get_number(arguments[index], out))
     {
-        out = std::stoi(arguments[index]);
-        if (size == 2)
-        {
-            // We default to assuming the value is in pixels
-            if (arguments[index + 1] == "ppt")
-            {
-                float ppt = static_cast<float>(out) / 100.f;
-                out = (float)total_size * ppt;
-            }
-        }
-
-        return true;
+        mir::log_error("Invalid argument: %s", std::string(arguments[index]).c_str());
+        return false;
     }
-    catch (std::invalid_argument const& e)
+
+    if (size == 2)
     {
-        mir::log_error("Invalid argument: %s", arguments[index].c_str());
-        return false;
+        // We default to assuming the value is in pixels
+        if (arguments[index + 1] == "ppt")
+        {
+            float ppt = static_cast<float>(out) / 100.f;
+            out = (float)total_size * ppt;
+        }
     }
+
+    return true;
 }
 }
 
-void I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandList const& command_list)
 {
     auto active_output = policy.get_active_output();
     if (!active_output)
     {
         mir::log_warning("process_move: output is not set");
-        return;
+        return false;
     }
 
     // https://i3wm.org/docs/userguide.html#_focusing_moving_containers
     if (command.arguments.empty())
     {
         mir::log_warning("process_move: move command expects arguments");
-        return;
+        return false;
     }
 
     int index = 0;
@@ -341,7 +442,7 @@ void I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandLi
         if (command.arguments.size() < 2)
         {
             mir::log_error("process_move: move position expected a third argument");
-            return;
+            return false;
         }
 
         auto const& arg1 = command.arguments[index++];
@@ -351,12 +452,12 @@ void I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandLi
             auto area = active_output->get_area();
             float x = (float)area.size.width.as_int() / 2.f - (float)active->get_visible_area().size.width.as_int() / 2.f;
             float y = (float)area.size.height.as_int() / 2.f - (float)active->get_visible_area().size.height.as_int() / 2.f;
-            policy.try_move_to((int)x, (int)y);
+            return policy.try_move_to((int)x, (int)y);
         }
         else if (arg1 == "mouse")
         {
             auto const& position = policy.get_cursor_position();
-            policy.try_move_to((int)position.x.as_int(), (int)position.y.as_int());
+            return policy.try_move_to((int)position.x.as_int(), (int)position.y.as_int());
         }
         else
         {
@@ -366,33 +467,38 @@ void I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandLi
             if (!parse_move_distance(command.arguments, index, total_size, move_distance_x))
             {
                 mir::log_error("process_move: move position <x> <y>: unable to parse x");
-                return;
+                return false;
             }
 
             if (!parse_move_distance(command.arguments, index, total_size, move_distance_y))
             {
                 mir::log_error("process_move: move position <x> <y>: unable to parse y");
-                return;
+                return false;
             }
 
-            policy.try_move_to(move_distance_x, move_distance_y);
+            return policy.try_move_to(move_distance_x, move_distance_y);
         }
-        return;
     }
     else if (arg0 == "absolute")
     {
+        if (command.arguments.size() < 3)
+        {
+            mir::log_error("process_move: move absolute expected 'position center'");
+            return false;
+        }
+
         auto const& arg1 = command.arguments[index++];
         auto const& arg2 = command.arguments[index++];
         if (arg1 != "position")
         {
             mir::log_error("process_move: move [absolute] ... expected 'position' as the third argument");
-            return;
+            return false;
         }
 
         if (arg2 != "center")
         {
             mir::log_error("process_move: move absolute position ... expected 'center' as the third argument");
-            return;
+            return false;
         }
 
         float x = 0, y = 0;
@@ -410,24 +516,29 @@ void I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandLi
         auto active = policy.get_state().active;
         float x_pos = x / 2.f - (float)active->get_visible_area().size.width.as_int() / 2.f;
         float y_pos = y / 2.f - (float)active->get_visible_area().size.height.as_int() / 2.f;
-        policy.try_move_to((int)x_pos, (int)y_pos);
-        return;
+        return policy.try_move_to((int)x_pos, (int)y_pos);
     }
     else if (arg0 == "window" || arg0 == "container")
     {
+        if (command.arguments.size() < 4)
+        {
+            mir::log_error("process_move: expected 'move window/container to workspace <name>'");
+            return false;
+        }
+
         auto const back_and_forth = std::find(command.options.begin(), command.options.end(), "--no-auto-back-and-forth") == command.options.end();
         auto const& arg1 = command.arguments[index++];
         if (arg1 != "to")
         {
             mir::log_error("process_move: expected 'to' after 'move window/container ...'");
-            return;
+            return false;
         }
 
         auto const& arg2 = command.arguments[index++];
         if (arg2 != "workspace")
         {
             mir::log_error("process_move: expected 'workspace' after 'move window/container to...'");
-            return;
+            return false;
         }
 
         auto const& arg3 = command.arguments[index++];
@@ -435,32 +546,28 @@ void I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandLi
         if (try_get_number(arg3, number))
         {
             // TODO: Do we need to care about the name here?
-            policy.move_active_to_workspace(number, back_and_forth);
-            return;
+            return policy.move_active_to_workspace(number, back_and_forth);
         }
         else if (arg3 == "next")
         {
-            policy.move_active_to_next();
-            return;
+            return policy.move_active_to_next();
         }
         else if (arg3 == "prev")
         {
-            policy.move_active_to_prev();
-            return;
+            return policy.move_active_to_prev();
         }
         else if (arg3 == "current")
         {
             // TODO: Support window selection
+            return false;
         }
         else if (arg3 == "back_and_forth")
         {
-            policy.move_active_to_back_and_forth();
-            return;
+            return policy.move_active_to_back_and_forth();
         }
         else
         {
-            policy.move_active_to_workspace_named(arg3, back_and_forth);
-            return;
+            return policy.move_active_to_workspace_named(std::string(arg3), back_and_forth);
         }
     }
 
@@ -468,33 +575,37 @@ void I3CommandExecutor::process_move(I3Command const& command, I3ScopedCommandLi
     {
         int move_distance;
         if (parse_move_distance(command.arguments, index, total_size, move_distance))
-            policy.try_move_by(direction, move_distance);
+            return policy.try_move_by(direction, move_distance);
         else
-            policy.try_move(direction);
+            return policy.try_move(direction);
     }
+
+    mir::log_warning("process_move: unknown argument %s", std::string(arg0).c_str());
+    return false;
 }
 
-void I3CommandExecutor::process_sticky(I3Command const& command, I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_sticky(I3Command const& command, I3ScopedCommandList const& command_list)
 {
     if (command.arguments.empty())
     {
         mir::log_warning("process_sticky: expects arguments");
-        return;
+        return false;
     }
 
     auto const& arg0 = command.arguments[0];
     if (arg0 == "enable")
-        policy.set_is_pinned(true);
+        return policy.set_is_pinned(true);
     else if (arg0 == "disable")
-        policy.set_is_pinned(false);
+        return policy.set_is_pinned(false);
     else if (arg0 == "toggle")
-        policy.toggle_pinned_to_workspace();
-    else
-        mir::log_warning("process_sticky: unknown arguments: %s", arg0.c_str());
+        return policy.toggle_pinned_to_workspace();
+
+    mir::log_warning("process_sticky: unknown arguments: %s", std::string(arg0).c_str());
+    return false;
 }
 
 // This command will be
-void I3CommandExecutor::process_input(I3Command const& command, I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_input(I3Command const& command, I3ScopedCommandList const& command_list)
 {
     // Payloads appear in the following format:
     //    [type:X, xkb_Y, Z]
@@ -504,7 +615,7 @@ void I3CommandExecutor::process_input(I3Command const& command, I3ScopedCommandL
     if (command.arguments.size() < 2)
     {
         mir::log_warning("process_input: expects at least 2 arguments");
-        return;
+        return false;
     }
 
     const char* const TYPE_PREFIX = "type:";
@@ -512,8 +623,8 @@ void I3CommandExecutor::process_input(I3Command const& command, I3ScopedCommandL
     std::string_view type_str = command.arguments[0];
     if (!type_str.starts_with("type:"))
     {
-        mir::log_warning("process_input: 'type' string is misformatted: %s", command.arguments[0].c_str());
-        return;
+        mir::log_warning("process_input: 'type' string is misformatted: %s", std::string(command.arguments[0]).c_str());
+        return false;
     }
 
     std::string_view type = type_str.substr(TYPE_PREFIX_LEN);
@@ -524,8 +635,8 @@ void I3CommandExecutor::process_input(I3Command const& command, I3ScopedCommandL
     const size_t XKB_PREFIX_LEN = strlen(XKB_PREFIX);
     if (!xkb_str.starts_with(XKB_PREFIX))
     {
-        mir::log_warning("process_input: 'xkb' string is misformatted: %s", command.arguments[1].c_str());
-        return;
+        mir::log_warning("process_input: 'xkb' string is misformatted: %s", std::string(command.arguments[1]).c_str());
+        return false;
     }
 
     std::string_view xkb_variable_name = xkb_str.substr(XKB_PREFIX_LEN);
@@ -534,7 +645,9 @@ void I3CommandExecutor::process_input(I3Command const& command, I3ScopedCommandL
         || xkb_variable_name == "variant"
         || xkb_variable_name == "options");
 
-    mir::log_info("Processing input from locale1: type=%s, xkb_variable=%s", type.data(), xkb_variable_name.data());
+    mir::log_info("Processing input from locale1: type=%.*s, xkb_variable=%.*s",
+        static_cast<int>(type.size()), type.data(),
+        static_cast<int>(xkb_variable_name.size()), xkb_variable_name.data());
 
     // TODO: This is where we need to process the request
     if (command.arguments.size() == 3)
@@ -547,101 +660,111 @@ void I3CommandExecutor::process_input(I3Command const& command, I3ScopedCommandL
     else
     {
         mir::log_warning("process_input: > 3 arguments were provided but only <= 3 are expected");
-        return;
+        return false;
     }
+
+    return true;
 }
 
-void I3CommandExecutor::process_workspace(I3Command const& command, I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_workspace(I3Command const& command, I3ScopedCommandList const& command_list)
 {
     if (command.arguments.empty())
     {
         mir::log_error("process_workspace: no arguments provided");
-        return;
+        return false;
     }
 
-    std::string const& arg0 = command.arguments[0];
+    auto const& arg0 = command.arguments[0];
     if (arg0 == "next")
-        policy.next_workspace();
+        return policy.next_workspace();
     else if (arg0 == "prev")
-        policy.prev_workspace();
+        return policy.prev_workspace();
     else if (arg0 == "next_on_output")
     {
         if (auto const* output = policy.get_active_output())
-            policy.next_workspace_on_output(*output);
+            return policy.next_workspace_on_output(*output);
         else
+        {
             mir::log_error("process_workspace: next_on_output has no output to go next on");
+            return false;
+        }
     }
     else if (arg0 == "prev_on_output")
     {
         if (auto const* output = policy.get_active_output())
-            policy.prev_workspace_on_output(*output);
+            return policy.prev_workspace_on_output(*output);
         else
+        {
             mir::log_error("process_workspace: prev_on_output has no output to go prev on");
+            return false;
+        }
     }
     else if (arg0 == "back_and_forth")
     {
-        policy.back_and_forth_workspace();
+        return policy.back_and_forth_workspace();
     }
     else
     {
-        std::string const* arg1 = &arg0;
+        std::string_view arg1 = arg0;
         auto const back_and_forth = std::find(command.options.begin(), command.options.end(), "--no-auto-back-and-forth") == command.options.end();
 
         int number = -1;
-        if (try_get_number(*arg1, number))
+        if (try_get_number(arg1, number))
         {
             // Check if we just have "workspace number"
             if (command.arguments.size() < 3)
-            {
-                policy.select_workspace(number, back_and_forth);
-                return;
-            }
+                return policy.select_workspace(number, back_and_forth);
 
             // We have "workspace number <name>"
-            arg1 = &command.arguments[2];
-            policy.select_workspace(*arg1, back_and_forth);
+            arg1 = command.arguments[2];
+            return policy.select_workspace(std::string(arg1), back_and_forth);
         }
         else
         {
             // We have "workspace <name>"
-            policy.select_workspace(*arg1, back_and_forth);
+            return policy.select_workspace(std::string(arg1), back_and_forth);
         }
     }
 }
 
-void I3CommandExecutor::process_layout(I3Command const& command, I3ScopedCommandList const& command_list)
+bool I3CommandExecutor::process_layout(I3Command const& command, I3ScopedCommandList const& command_list)
 {
     // https://i3wm.org/docs/userguide.html#manipulating_layout
-    std::string const& arg0 = command.arguments[0];
+    if (command.arguments.empty())
+    {
+        mir::log_error("process_layout: no arguments provided");
+        return false;
+    }
+
+    auto const& arg0 = command.arguments[0];
     if (arg0 == "default")
-        policy.set_layout_default();
+        return policy.set_layout_default();
     else if (arg0 == "tabbed")
-        policy.set_layout(LayoutScheme::tabbing);
+        return policy.set_layout(LayoutScheme::tabbing);
     else if (arg0 == "stacking")
-        policy.set_layout(LayoutScheme::stacking);
+        return policy.set_layout(LayoutScheme::stacking);
     else if (arg0 == "splitv")
-        policy.set_layout(LayoutScheme::vertical);
+        return policy.set_layout(LayoutScheme::vertical);
     else if (arg0 == "splith")
-        policy.set_layout(LayoutScheme::horizontal);
+        return policy.set_layout(LayoutScheme::horizontal);
     else if (arg0 == "toggle")
     {
         if (command.arguments.size() == 1)
         {
             mir::log_error("process_layout: expected argument after 'layout toggle ...'");
-            return;
+            return false;
         }
 
         if (command.arguments.size() == 2)
         {
             auto const& arg1 = command.arguments[1];
             if (arg1 == "split")
-                policy.try_toggle_layout(false);
+                return policy.try_toggle_layout(false);
             else if (arg1 == "all")
-                policy.try_toggle_layout(true);
-            else
-                mir::log_error("process_layout: expected split/all after 'layout toggle X'");
+                return policy.try_toggle_layout(true);
 
-            return;
+            mir::log_error("process_layout: expected split/all after 'layout toggle X'");
+            return false;
         }
         else
         {
@@ -649,7 +772,7 @@ void I3CommandExecutor::process_layout(I3Command const& command, I3ScopedCommand
             if (!container)
             {
                 mir::log_error("process_layout: container unavailable");
-                return;
+                return false;
             }
 
             auto current_type = container->get_layout();
@@ -705,15 +828,21 @@ void I3CommandExecutor::process_layout(I3Command const& command, I3ScopedCommand
 
             auto const& target = command.arguments[index];
             if (target == "split")
-                policy.try_toggle_layout(false);
+                return policy.try_toggle_layout(false);
             else if (target == "tabbed")
-                policy.set_layout(LayoutScheme::tabbing);
+                return policy.set_layout(LayoutScheme::tabbing);
             else if (target == "stacking")
-                policy.set_layout(LayoutScheme::stacking);
+                return policy.set_layout(LayoutScheme::stacking);
             else if (target == "splitv")
-                policy.set_layout(LayoutScheme::vertical);
+                return policy.set_layout(LayoutScheme::vertical);
             else if (target == "splith")
-                policy.set_layout(LayoutScheme::horizontal);
+                return policy.set_layout(LayoutScheme::horizontal);
+
+            mir::log_error("process_layout: unknown layout %s", std::string(target).c_str());
+            return false;
         }
     }
+
+    mir::log_error("process_layout: unknown argument %s", std::string(arg0).c_str());
+    return false;
 }
\ No newline at end of file
@@ -28,6 +28,15 @@ class Policy;
 class WorkspaceManager;
 class AutoRestartingLauncher;
 class WindowController;
+class WindowIndex;
+
+/// The outcome of a single [I3Command]. One of these is reported
+/// back to the IPC client for each command that it sent.
+struct I3CommandResult
+{
+    bool success = false;
+    std::string error;
+};
 
 /// Processes all commands coming from i3 IPC. This class is mostly for organizational
 /// purposes, as a lot of logic is associated with processing these operations.
@@ -39,8 +48,12 @@ public:
         WorkspaceManager&,
         miral::WindowManagerTools const&,
         AutoRestartingLauncher&,
-        WindowController&);
-    void process(I3ScopedCommandList const&);
+        WindowController&,
+        WindowIndex const&);
+
+    /// Processes each command in the list. A scoped command that acts on a window, such
+    /// as move or layout, is applied to every window that meets the criteria.
+    std::vector<I3CommandResult> process(I3ScopedCommandList const&);
 
 private:
     Policy& policy;
@@ -48,16 +61,23 @@ private:
     miral::WindowManagerTools tools;
     AutoRestartingLauncher& launcher;
     WindowController& window_controller;
+    WindowIndex const& window_index;
+
+    /// Processes a single command against the active window.
+    I3CommandResult process_command(I3Command const&, I3ScopedCommandList const&);
 
-    miral::Window get_window_meeting_criteria(I3ScopedCommandList const&);
-    void process_exec(I3Command const&, I3ScopedCommandList const&);
-    void process_split(I3Command const&, I3ScopedCommandList const&);
-    void process_focus(I3Command const&, I3ScopedCommandList const&);
-    void process_move(I3Command const&, I3ScopedCommandList const&);
-    void process_sticky(I3Command const&, I3ScopedCommandList const&);
-    void process_input(I3Command const&, I3ScopedCommandList const&);
-    void process_workspace(I3Command const&, I3ScopedCommandList const&);
-    void process_layout(I3Command const&, I3ScopedCommandList const&);
+    /// Returns every window that meets the criteria of the command list, from the most
+    /// to the least recently focused. Where a command can only act on one window, such
+    /// as focus, it acts on the first.
+    std::vector<miral::Window> get_windows_meeting_criteria(I3ScopedCommandList const&);
+    bool process_exec(I3Command const&, I3ScopedCommandList const&);
+    bool process_split(I3Command const&, I3ScopedCommandList const&);
+    bool process_focus(I3Command const&, I3ScopedCommandList const&);
+    bool process_move(I3Command const&, I3ScopedCommandList const&);
+    bool process_sticky(I3Command const&, I3ScopedCommandList const&);
+    bool process_input(I3Command const&, I3ScopedCommandList const&);
+    bool process_workspace(I3Command const&, I3ScopedCommandList const&);
+    bool process_layout(I3Command const&, I3ScopedCommandList const&);
 };
 
 } // miracle
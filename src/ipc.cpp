@@ -19,17 +19,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ipc.h"
 #include "config.h"
+#include "container.h"
 #include "i3_command_executor.h"
+#include "layout_transaction.h"
 #include "output.h"
 #include "policy.h"
 #include "version.h"
 #include "workspace.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <mir/log.h>
 #include <nlohmann/json.hpp>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -39,6 +43,7 @@ using namespace miracle;
 static const char ipc_magic[] = { 'i', '3', '-', 'i', 'p', 'c' };
 
 #define IPC_HEADER_SIZE (sizeof(ipc_magic) + 8)
+#define MAX_PENDING_WRITE_SIZE (4 * 1024 * 1024) // 4 MB
 #define event_mask(ev) (1 << (ev & 0x7F))
 
 namespace
@@ -216,6 +221,30 @@ json mode_event_to_json(WindowManagerMode mode)
     }
     }
 }
+
+char const* window_change_to_string(WindowChange change)
+{
+    switch (change)
+    {
+    case WindowChange::created:
+        return "new";
+    case WindowChange::closed:
+        return "close";
+    case WindowChange::focused:
+        return "focus";
+    case WindowChange::title:
+        return "title";
+    case WindowChange::moved:
+        return "move";
+    case WindowChange::fullscreen_mode:
+        return "fullscreen_mode";
+    default:
+    {
+        mir::fatal_error("window_change_to_string: unknown window change: %d", (int)change);
+        return {};
+    }
+    }
+}
 }
 
 Ipc::Ipc(miral::MirRunner& runner,
@@ -301,10 +330,11 @@ Ipc::Ipc(miral::MirRunner& runner,
         }
 
         auto mir_fd = mir::Fd { client_fd };
-        clients.push_back({ mir_fd,
-            runner.register_fd_handler(mir_fd, [this](int fd)
+        auto [it, inserted] = clients.emplace(client_fd, IpcClient { mir_fd, runner.register_fd_handler(mir_fd, [this](int fd)
         {
             auto& client = get_client(fd);
+            if (client.is_disconnected)
+                return;
 
             int read_available;
             if (ioctl(client.client_fd, FIONREAD, &read_available) == -1)
@@ -314,6 +344,17 @@ Ipc::Ipc(miral::MirRunner& runner,
                 return;
             }
 
+            if (read_available == 0)
+            {
+                // A readable socket without any data means that the client hung up.
+                char peek;
+                if (recv(client.client_fd, &peek, 1, MSG_PEEK) == 0)
+                {
+                    disconnect(client);
+                    return;
+                }
+            }
+
             if (client.pending_read_length > 0)
             {
                 if ((uint32_t)read_available >= client.pending_read_length)
@@ -362,11 +403,13 @@ Ipc::Ipc(miral::MirRunner& runner,
                 handle_command(client, pending_length, pending_type);
             }
         }) });
+        it->second.id = next_client_id++;
     });
 }
 
 Ipc::~Ipc()
 {
+    queue->pause_processing_for(this);
 }
 
 void Ipc::on_created(Output const& info, int key)
@@ -378,15 +421,7 @@ void Ipc::on_created(Output const& info, int key)
     };
 
     auto serialized_value = to_string(j);
-    for (auto& client : clients)
-    {
-        if ((client.subscribed_events & event_mask(IPC_EVENT_WORKSPACE)) == 0)
-        {
-            continue;
-        }
-
-        send_reply(client, IPC_EVENT_WORKSPACE, serialized_value);
-    }
+    broadcast(IPC_EVENT_WORKSPACE, serialized_value);
 }
 
 void Ipc::on_removed(Output const& screen, int key)
@@ -397,15 +432,7 @@ void Ipc::on_removed(Output const& screen, int key)
     };
 
     auto serialized_value = to_string(j);
-    for (auto& client : clients)
-    {
-        if ((client.subscribed_events & event_mask(IPC_EVENT_WORKSPACE)) == 0)
-        {
-            continue;
-        }
-
-        send_reply(client, IPC_EVENT_WORKSPACE, serialized_value);
-    }
+    broadcast(IPC_EVENT_WORKSPACE, serialized_value);
 }
 
 void Ipc::on_focused(
@@ -425,28 +452,83 @@ void Ipc::on_focused(
         j["old"] = nullptr;
 
     auto serialized_value = to_string(j);
-    for (auto& client : clients)
+    broadcast(IPC_EVENT_WORKSPACE, serialized_value);
+}
+
+void Ipc::on_changed(WindowManagerMode mode)
+{
+    auto response = to_string(mode_event_to_json(mode));
+    broadcast(IPC_EVENT_MODE, response);
+}
+
+void Ipc::on_window_changed(WindowChange change, std::shared_ptr<Container> const& container)
+{
+    std::lock_guard lock(pending_window_events_mutex);
+    bool const needs_send = pending_window_events.empty();
+    if (change == WindowChange::closed)
+    {
+        // Any other event for this container is now irrelevant. Earlier close events
+        // are kept, as their containers are expected to have expired already.
+        pending_window_events.erase(std::remove_if(
+                                        pending_window_events.begin(),
+                                        pending_window_events.end(),
+                                        [&](PendingWindowEvent const& event)
+        {
+            return event.change != WindowChange::closed
+                && (event.container.expired() || event.container.lock() == container);
+        }),
+            pending_window_events.end());
+        pending_window_events.push_back({ change, container, container->to_json() });
+    }
+    else
     {
-        if ((client.subscribed_events & event_mask(IPC_EVENT_WORKSPACE)) == 0)
+        // A repeated event moves to the back so that the last event that the subscribers
+        // receive matches the final state, as with focus moving from A to B and back to A
+        auto const existing = std::find_if(
+            pending_window_events.begin(),
+            pending_window_events.end(),
+            [&](PendingWindowEvent const& event)
         {
-            continue;
+            return event.change == change && event.container.lock() == container;
+        });
+        if (existing != pending_window_events.end())
+        {
+            std::rotate(existing, existing + 1, pending_window_events.end());
+            return;
         }
 
-        send_reply(client, IPC_EVENT_WORKSPACE, serialized_value);
+        pending_window_events.push_back({ change, container, {} });
     }
+
+    if (needs_send)
+        queue->enqueue(this, [this]() { send_pending_window_events(); });
 }
 
-void Ipc::on_changed(WindowManagerMode mode)
+void Ipc::send_pending_window_events()
 {
-    auto response = to_string(mode_event_to_json(mode));
-    for (auto& client : clients)
+    std::vector<PendingWindowEvent> events;
     {
-        if ((client.subscribed_events & event_mask(IPC_EVENT_MODE)) == 0)
-        {
+        std::lock_guard lock(pending_window_events_mutex);
+        events.swap(pending_window_events);
+    }
+
+    for (auto const& event : events)
+    {
+        json container;
+        if (event.change == WindowChange::closed)
+            container = event.closed_container;
+        else if (auto c = event.container.lock())
+            container = c->to_json();
+        else
             continue;
-        }
 
-        send_reply(client, IPC_EVENT_MODE, response);
+        json j = {
+            { "change",    window_change_to_string(event.change) },
+            { "container", container                             }
+        };
+
+        auto serialized_value = to_string(j);
+        broadcast(IPC_EVENT_WINDOW, serialized_value);
     }
 }
 
@@ -455,88 +537,102 @@ void Ipc::on_shutdown()
     auto response = to_string(json({
         { "change", "exit" }
     }));
-    for (auto& client : clients)
-    {
-        if ((client.subscribed_events & event_mask(IPC_EVENT_SHUTDOWN)) == 0)
-        {
-            continue;
-        }
-
-        send_reply(client, IPC_EVENT_SHUTDOWN, response);
-    }
+    broadcast(IPC_EVENT_SHUTDOWN, response);
 }
 
 Ipc::IpcClient& Ipc::get_client(int fd)
 {
-    for (auto& client : clients)
-    {
-        if (client.client_fd == fd)
-            return client;
-    }
+    auto it = clients.find(fd);
+    if (it != clients.end())
+        return it->second;
 
     throw std::runtime_error("Could not find IPC client");
 }
 
 void Ipc::disconnect(Ipc::IpcClient& client)
 {
-    auto it = std::find_if(clients.begin(), clients.end(), [&](IpcClient const& other)
-    {
-        return other.client_fd.operator int() == client.client_fd.operator int();
-    });
-    if (it != clients.end())
+    if (client.is_disconnected)
+        return;
+
+    int fd = client.client_fd;
+    if (!clients.contains(fd))
     {
-        if (fd_is_valid(client.client_fd))
-            shutdown(client.client_fd, SHUT_RDWR);
-        mir::log_info("Disconnected client: %d", (int)client.client_fd);
-        clients.erase(it);
+        mir::log_error("Unable to disconnect client");
+        return;
     }
-    else
+
+    if (fd_is_valid(fd))
+        shutdown(fd, SHUT_RDWR);
+    mir::log_info("Disconnected client: %d", fd);
+
+    // While the clients are being iterated, the client is only marked as disconnected
+    // so that the iterator remains valid. It is erased once the iteration ends.
+    if (client_iteration_depth > 0)
     {
-        mir::log_error("Unable to disconnect client");
+        client.is_disconnected = true;
+        disconnected_clients.push_back(fd);
+        return;
     }
+
+    clients.erase(fd);
 }
 
-void Ipc::handle_command(miracle::Ipc::IpcClient& client, uint32_t payload_length, miracle::IpcCommandType payload_type)
+void Ipc::for_each_subscriber(IpcCommandType event_type, std::function<void(IpcClient&)> const& f)
 {
-    char* buf = (char*)malloc(payload_length + 1);
-    if (!buf)
+    client_iteration_depth++;
+    for (auto& [fd, client] : clients)
     {
-        mir::log_error("Unable to allocate IPC payload");
-        disconnect(client);
-        return;
+        if (client.is_disconnected || (client.subscribed_events & event_mask(event_type)) == 0)
+            continue;
+
+        f(client);
     }
+    client_iteration_depth--;
+
+    if (client_iteration_depth == 0)
+        remove_disconnected_clients();
+}
+
+void Ipc::remove_disconnected_clients()
+{
+    for (auto fd : disconnected_clients)
+        clients.erase(fd);
+    disconnected_clients.clear();
+}
 
+void Ipc::handle_command(miracle::Ipc::IpcClient& client, uint32_t payload_length, miracle::IpcCommandType payload_type)
+{
+    std::string buf(payload_length, '\0');
     if (payload_length > 0)
     {
         // Payload should be fully available
-        ssize_t received = recv(client.client_fd, buf, payload_length, 0);
+        ssize_t received = recv(client.client_fd, buf.data(), payload_length, 0);
         if (received == -1)
         {
             mir::log_error("Unable to receive payload from IPC client");
             disconnect(client);
-            free(buf);
             return;
         }
     }
-    buf[payload_length] = '\0';
 
     switch (payload_type)
     {
     case IPC_COMMAND:
     {
-        auto result = parse_i3_command(std::string_view(buf));
-        if (result)
-        {
-            const std::string msg = "[{\"success\": true}]";
-            send_reply(client, payload_type, msg);
-        }
-        else
+        // On success, the reply is sent once the commands have been executed
+        if (!parse_i3_command(client, std::string_view(buf)))
         {
             const std::string msg = "[{\"success\": false, \"parse_error\": true}]";
             send_reply(client, payload_type, msg);
         }
         break;
     }
+    case IPC_SYNC:
+    {
+        // The reply is sent once every command that was received before this has been executed
+        enqueue_command({ client.client_fd, client.id, payload_type, {} });
+        break;
+    }
     case IPC_GET_WORKSPACES:
     {
         json j = json::array();
@@ -564,7 +660,6 @@ void Ipc::handle_command(miracle::Ipc::IpcClient& client, uint32_t payload_lengt
     case IPC_SUBSCRIBE:
     {
         json j = json::parse(buf);
-        bool success = true;
         bool send_event_tick = false;
         for (auto const& i : j)
         {
@@ -589,16 +684,12 @@ void Ipc::handle_command(miracle::Ipc::IpcClient& client, uint32_t payload_lengt
             {
                 mir::log_error("Cannot process IPC subscription event for event_type: %s", event_type.c_str());
                 disconnect(client);
-                success = false;
-                break;
+                return;
             }
         }
 
-        if (success)
-        {
-            const std::string msg = "{\"success\": true}";
-            send_reply(client, payload_type, msg);
-        }
+        const std::string msg = "{\"success\": true}";
+        send_reply(client, payload_type, msg);
 
         if (send_event_tick)
         {
@@ -649,19 +740,12 @@ void Ipc::handle_command(miracle::Ipc::IpcClient& client, uint32_t payload_lengt
         const std::string msg = "{\"success\": true}";
         send_reply(client, payload_type, msg);
 
-        for (auto& other_client : clients)
-        {
-            if ((other_client.subscribed_events & event_mask(IPC_EVENT_TICK)) == 0)
-            {
-                continue;
-            }
-
-            json response = {
-                { "first",   false            },
-                { "payload", std::string(buf) }
-            };
-            send_reply(other_client, IPC_EVENT_TICK, to_string(response));
-        }
+        json response = {
+            { "first",   false },
+            { "payload", buf   }
+        };
+        auto serialized_value = to_string(response);
+        broadcast(IPC_EVENT_TICK, serialized_value);
         break;
     }
     default:
@@ -671,8 +755,42 @@ void Ipc::handle_command(miracle::Ipc::IpcClient& client, uint32_t payload_lengt
     }
 }
 
+std::shared_ptr<Ipc::IpcFrame const> Ipc::make_frame(IpcCommandType command_type, std::string const& payload)
+{
+    const uint32_t payload_length = payload.size();
+    const auto casted_command = static_cast<uint32_t>(command_type);
+
+    auto frame = std::make_shared<IpcFrame>();
+    frame->data.resize(IPC_HEADER_SIZE + payload_length);
+    memcpy(frame->data.data(), ipc_magic, sizeof(ipc_magic));
+    memcpy(frame->data.data() + sizeof(ipc_magic), &payload_length, sizeof(payload_length));
+    memcpy(frame->data.data() + sizeof(ipc_magic) + sizeof(payload_length), &casted_command, sizeof(casted_command));
+    memcpy(frame->data.data() + IPC_HEADER_SIZE, payload.data(), payload_length);
+    return frame;
+}
+
 void Ipc::send_reply(miracle::Ipc::IpcClient& client, miracle::IpcCommandType command_type, const std::string& payload)
 {
+    send_frame(client, make_frame(command_type, payload));
+}
+
+void Ipc::broadcast(IpcCommandType event_type, std::string const& payload)
+{
+    std::shared_ptr<IpcFrame const> frame;
+    for_each_subscriber(event_type, [&](IpcClient& client)
+    {
+        // The frame is only built once somebody is actually listening
+        if (!frame)
+            frame = make_frame(event_type, payload);
+        send_frame(client, frame);
+    });
+}
+
+void Ipc::send_frame(IpcClient& client, std::shared_ptr<IpcFrame const> const& frame)
+{
+    if (client.is_disconnected)
+        return;
+
     if (!fd_is_valid(client.client_fd.operator int()))
     {
         mir::log_warning("Unable to send reply to client: file descriptor is invalid");
@@ -680,68 +798,43 @@ void Ipc::send_reply(miracle::Ipc::IpcClient& client, miracle::IpcCommandType co
         return;
     }
 
-    const uint32_t payload_length = payload.size();
-    char data[IPC_HEADER_SIZE];
-
-    const auto casted_command = static_cast<uint32_t>(command_type);
-    memcpy(data, ipc_magic, sizeof(ipc_magic));
-    memcpy(data + sizeof(ipc_magic), &payload_length, sizeof(payload_length));
-    memcpy(data + sizeof(ipc_magic) + sizeof(payload_length), &casted_command, sizeof(casted_command));
-
-    auto new_buffer_size = client.buffer.size();
-    while (client.write_buffer_len + IPC_HEADER_SIZE + payload_length >= new_buffer_size)
+    if (client.pending_write_size + frame->data.size() > MAX_PENDING_WRITE_SIZE)
     {
-        if (new_buffer_size == 0)
-            new_buffer_size = 1;
-        new_buffer_size *= 2;
-    }
-
-    if (new_buffer_size > 4e6)
-    { // 4 MB
-        mir::log_error("Client write buffer too big (%zu), disconnecting client", client.buffer.size());
+        mir::log_error("Client write buffer too big (%zu), disconnecting client", client.pending_write_size);
         disconnect(client);
         return;
     }
 
-    client.buffer.resize(new_buffer_size);
-
-    memcpy(client.buffer.data() + client.write_buffer_len, data, IPC_HEADER_SIZE);
-    client.write_buffer_len += IPC_HEADER_SIZE;
-    memcpy(client.buffer.data() + client.write_buffer_len, payload.c_str(), payload_length);
-    client.write_buffer_len += payload_length;
+    client.write_queue.push_back(frame);
+    client.pending_write_size += frame->data.size();
     handle_writeable(client);
 }
 
-namespace
-{
-// https://stackoverflow.com/questions/24920748/how-to-handle-a-sigpipe-error-inside-the-object-that-generated-it
-ssize_t write_nosigpipe(int fd, void* buf, size_t len)
+void Ipc::handle_writeable(miracle::Ipc::IpcClient& client)
 {
-    sigset_t oldset, newset;
-    ssize_t result;
-    siginfo_t si;
-    struct timespec ts = { 0 };
-
-    sigemptyset(&newset);
-    sigaddset(&newset, SIGPIPE);
-    pthread_sigmask(SIG_BLOCK, &newset, &oldset);
-
-    result = write(fd, buf, len);
+    constexpr size_t max_frames_per_write = 16;
+    while (!client.write_queue.empty())
+    {
+        iovec iov[max_frames_per_write];
+        size_t num_iov = 0;
+        for (auto const& frame : client.write_queue)
+        {
+            if (num_iov == max_frames_per_write)
+                break;
 
-    while (sigtimedwait(&newset, &si, &ts) >= 0 || errno != EAGAIN)
-        ;
-    pthread_sigmask(SIG_SETMASK, &oldset, 0);
+            size_t offset = num_iov == 0 ? client.write_offset : 0;
+            iov[num_iov].iov_base = const_cast<char*>(frame->data.data() + offset);
+            iov[num_iov].iov_len = frame->data.size() - offset;
+            num_iov++;
+        }
 
-    return result;
-}
-}
+        msghdr message {};
+        message.msg_iov = iov;
+        message.msg_iovlen = num_iov;
 
-void Ipc::handle_writeable(miracle::Ipc::IpcClient& client)
-{
-    while (client.write_buffer_len > 0)
-    {
-        ssize_t written = write_nosigpipe(client.client_fd, client.buffer.data(), client.write_buffer_len);
-        if (written == -1 && errno == EAGAIN)
+        // MSG_NOSIGNAL prevents a SIGPIPE when the client has gone away
+        ssize_t written = sendmsg(client.client_fd, &message, MSG_NOSIGNAL);
+        if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
         {
             return;
         }
@@ -752,11 +845,22 @@ void Ipc::handle_writeable(miracle::Ipc::IpcClient& client)
             return;
         }
 
-        memmove(client.buffer.data(), client.buffer.data() + written, client.write_buffer_len - written);
-        client.write_buffer_len -= written;
-    }
+        client.pending_write_size -= written;
+        size_t remaining = written;
+        while (remaining > 0)
+        {
+            size_t frame_remaining = client.write_queue.front()->data.size() - client.write_offset;
+            if (remaining < frame_remaining)
+            {
+                client.write_offset += remaining;
+                break;
+            }
 
-    client.write_buffer_len = 0;
+            remaining -= frame_remaining;
+            client.write_queue.pop_front();
+            client.write_offset = 0;
+        }
+    }
 }
 
 namespace
@@ -768,25 +872,63 @@ bool equals(std::string_view const& s, const char* v)
 }
 }
 
-bool Ipc::parse_i3_command(std::string_view const& command)
+bool Ipc::parse_i3_command(IpcClient& client, std::string_view const& command)
+{
+    auto commands = I3ScopedCommandList::parse(command);
+    if (commands.empty())
+        return false;
+
+    enqueue_command({ client.client_fd, client.id, IPC_COMMAND, std::move(commands) });
+    return true;
+}
+
+void Ipc::enqueue_command(PendingCommand&& command)
 {
+    pending_commands.push_back(std::move(command));
+    queue->enqueue(this, [this]() { process_next_command(); });
+}
+
+void Ipc::process_next_command()
+{
+    if (pending_commands.empty())
     {
-        std::unique_lock lock(pending_commands_mutex);
-        pending_commands = I3ScopedCommandList::parse(command);
+        mir::log_error("process_next_command: there are no pending commands");
+        return;
     }
 
-    queue->enqueue(this, [&]()
+    auto pending = std::move(pending_commands.front());
+    pending_commands.pop_front();
+
+    json response;
+    if (pending.type == IPC_SYNC)
     {
-        size_t num_processed = 0;
+        response = { { "success", true } };
+    }
+    else
+    {
+        // Every command in the payload mutates the tree first, and the
+        // resulting layout is committed once when the transaction ends
+        LayoutTransaction transaction;
+        response = json::array();
+        for (auto const& c : pending.commands)
         {
-            std::shared_lock lock(pending_commands_mutex);
-            for (auto const& c : pending_commands)
-                executor.process(c);
-            num_processed = pending_commands.size();
+            for (auto const& result : executor.process(c))
+            {
+                if (result.success)
+                    response.push_back(json { { "success", true } });
+                else
+                    response.push_back(json {
+                        { "success", false        },
+                        { "error",   result.error }
+                    });
+            }
         }
+    }
 
-        std::unique_lock lock(pending_commands_mutex);
-        pending_commands.erase(pending_commands.begin(), pending_commands.begin() + num_processed);
-    });
-    return true;
+    // The client may have disconnected while its commands were waiting to run
+    auto it = clients.find(pending.client_fd);
+    if (it == clients.end() || it->second.id != pending.client_id)
+        return;
+
+    send_reply(it->second, pending.type, to_string(response));
 }
@@ -21,12 +21,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "i3_command.h"
 #include "i3_command_executor.h"
 #include "mode_observer.h"
+#include "window_observer.h"
 #include "workspace_manager.h"
 #include "workspace_observer.h"
 #include <mir/fd.h>
 #include <mir/server_action_queue.h>
 #include <miral/runner.h>
-#include <shared_mutex>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <unordered_map>
 #include <vector>
 
 struct sockaddr_un;
@@ -78,7 +83,7 @@ enum IpcCommandType
 /// This class will implement I3's interface: https://i3wm.org/docs/ipc.html
 /// plus some of the sway-specific items.
 /// It may be extended in the future.
-class Ipc : public virtual WorkspaceObserver, public virtual ModeObserver
+class Ipc : public virtual WorkspaceObserver, public virtual ModeObserver, public virtual WindowObserver
 {
 public:
     Ipc(miral::MirRunner& runner,
@@ -93,18 +98,50 @@ public:
     void on_removed(Output const& info, int key) override;
     void on_focused(Output const* previous, int, Output const* current, int) override;
     void on_changed(WindowManagerMode mode) override;
+    void on_window_changed(WindowChange change, std::shared_ptr<Container> const& container) override;
     void on_shutdown();
 
 private:
+    /// A fully encoded message, header included. Frames are immutable so that
+    /// a single event can be queued on every subscriber without being copied.
+    struct IpcFrame
+    {
+        std::string data;
+    };
+
     struct IpcClient
     {
         mir::Fd client_fd;
         std::unique_ptr<miral::FdHandle> handle;
         uint32_t pending_read_length = 0;
         IpcCommandType pending_type;
-        std::vector<char> buffer;
-        int write_buffer_len = 0;
+        std::deque<std::shared_ptr<IpcFrame const>> write_queue;
+
+        /// How much of the frame at the front of [write_queue] has already been written.
+        size_t write_offset = 0;
+
+        /// The total number of bytes waiting in [write_queue].
+        size_t pending_write_size = 0;
         int subscribed_events = 0;
+
+        /// Set when the client has been disconnected but could not yet be
+        /// removed from [clients] because the map was being iterated.
+        bool is_disconnected = false;
+
+        /// Uniquely identifies this client, even after its fd is reused.
+        uint64_t id = 0;
+    };
+
+    /// A window event that has yet to be sent to the subscribers. Events are
+    /// coalesced until the main loop gets around to sending them.
+    struct PendingWindowEvent
+    {
+        WindowChange change;
+        std::weak_ptr<Container> container;
+
+        /// Closed containers are serialized immediately, as they will
+        /// not be around by the time that the event is sent.
+        nlohmann::json closed_container;
     };
 
     WorkspaceManager& workspace_manager;
@@ -112,19 +149,53 @@ private:
     mir::Fd ipc_socket;
     std::unique_ptr<miral::FdHandle> socket_handle;
     sockaddr_un* ipc_sockaddr = nullptr;
-    std::vector<IpcClient> clients;
-    std::vector<I3ScopedCommandList> pending_commands;
-    mutable std::shared_mutex pending_commands_mutex;
+
+    /// Clients keyed by their file descriptor. The nodes of an unordered_map are
+    /// stable, so a reference to a client stays valid while other clients connect.
+    std::unordered_map<int, IpcClient> clients;
+
+    /// File descriptors of the clients that were disconnected while [clients]
+    /// was being iterated. These are erased once the outermost iteration ends.
+    std::vector<int> disconnected_clients;
+    int client_iteration_depth = 0;
+
+    /// The commands of a single IPC_COMMAND message along with the client that sent them.
+    /// An IPC_SYNC message is queued as a [PendingCommand] without any commands so
+    /// that it is answered only once everything that came before it has run.
+    struct PendingCommand
+    {
+        int client_fd;
+        uint64_t client_id;
+        IpcCommandType type;
+        std::vector<I3ScopedCommandList> commands;
+    };
+
+    /// Commands that have been parsed but not yet executed, in the order that they
+    /// were received. Each entry is paired with exactly one action on [queue].
+    /// Both the client handlers that push onto this queue and the actions that pop
+    /// from it run on the main loop, so the queue does not need to be locked.
+    std::deque<PendingCommand> pending_commands;
+    uint64_t next_client_id = 1;
     std::shared_ptr<mir::ServerActionQueue> queue;
     I3CommandExecutor& executor;
     std::shared_ptr<MiracleConfig> config;
+    std::vector<PendingWindowEvent> pending_window_events;
+    std::mutex pending_window_events_mutex;
 
     void disconnect(IpcClient& client);
     IpcClient& get_client(int fd);
+    void for_each_subscriber(IpcCommandType event_type, std::function<void(IpcClient&)> const& f);
+    void remove_disconnected_clients();
     void handle_command(IpcClient& client, uint32_t payload_length, IpcCommandType payload_type);
+    static std::shared_ptr<IpcFrame const> make_frame(IpcCommandType command_type, std::string const& payload);
     void send_reply(IpcClient& client, IpcCommandType command_type, std::string const& payload);
+    void broadcast(IpcCommandType event_type, std::string const& payload);
+    void send_frame(IpcClient& client, std::shared_ptr<IpcFrame const> const& frame);
     void handle_writeable(IpcClient& client);
-    bool parse_i3_command(std::string_view const& command);
+    void send_pending_window_events();
+    bool parse_i3_command(IpcClient& client, std::string_view const& command);
+    void enqueue_command(PendingCommand&& command);
+    void process_next_command();
 };
 }
 
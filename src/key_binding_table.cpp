@@ -0,0 +1,71 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "key_binding_table.h"
+
+using namespace miracle;
+
+namespace
+{
+uint resolve_modifiers(uint modifiers, uint primary_modifier)
+{
+    if (modifiers & miracle_input_event_modifier_default)
+        return (modifiers & ~miracle_input_event_modifier_default) | primary_modifier;
+    return modifiers;
+}
+}
+
+KeyBindingTable::KeyBindingTable(
+    std::vector<CustomKeyCommand> const& custom_key_commands,
+    KeyCommandList const (&key_commands)[DefaultKeyCommand::MAX],
+    uint primary_modifier)
+{
+    for (auto const& command : custom_key_commands)
+    {
+        auto& entry = entries[{ command.action, command.key, resolve_modifiers(command.modifiers, primary_modifier) }];
+        if (!entry.custom_command)
+            entry.custom_command = command;
+    }
+
+    for (int i = 0; i < DefaultKeyCommand::MAX; i++)
+    {
+        for (auto const& command : key_commands[i])
+        {
+            auto& entry = entries[{ command.action, command.key, resolve_modifiers(command.modifiers, primary_modifier) }];
+            entry.default_commands.push_back(static_cast<DefaultKeyCommand>(i));
+        }
+    }
+}
+
+KeyBindingTable::Entry const* KeyBindingTable::find(MirKeyboardAction action, int scan_code, uint modifiers) const
+{
+    auto it = entries.find({ action, scan_code, modifiers });
+    if (it == entries.end())
+        return nullptr;
+
+    return &it->second;
+}
+
+size_t KeyBindingTable::KeyHash::operator()(Key const& key) const
+{
+    // Scan codes fit in 16 bits and there are only a handful of actions, so
+    // every field packs into a single integer without overlapping
+    auto const packed = (static_cast<uint64_t>(key.modifiers) << 32)
+        | (static_cast<uint64_t>(static_cast<uint16_t>(key.scan_code)) << 8)
+        | static_cast<uint64_t>(static_cast<uint8_t>(key.action));
+    return std::hash<uint64_t> {}(packed);
+}
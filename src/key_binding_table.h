@@ -0,0 +1,74 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLEWM_KEY_BINDING_TABLE_H
+#define MIRACLEWM_KEY_BINDING_TABLE_H
+
+#include "config.h"
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace miracle
+{
+
+/// Every key binding in the configuration, compiled into a hash table that is keyed
+/// by the exact event that triggers the binding. The primary modifier is resolved
+/// when the table is built, so a lookup is a single hash of the incoming event.
+///
+/// A table is immutable once built. Reloading the configuration builds a new table.
+class KeyBindingTable
+{
+public:
+    /// Everything that a single key event is bound to, in the order that it should be tried.
+    struct Entry
+    {
+        /// The first custom command bound to the event, which takes precedence over the defaults.
+        std::optional<CustomKeyCommand> custom_command;
+        std::vector<DefaultKeyCommand> default_commands;
+    };
+
+    KeyBindingTable(
+        std::vector<CustomKeyCommand> const& custom_key_commands,
+        KeyCommandList const (&key_commands)[DefaultKeyCommand::MAX],
+        uint primary_modifier);
+
+    /// Returns the bindings for the event, or nullptr if there are none.
+    [[nodiscard]] Entry const* find(MirKeyboardAction action, int scan_code, uint modifiers) const;
+
+private:
+    struct Key
+    {
+        MirKeyboardAction action;
+        int scan_code;
+        uint modifiers;
+
+        bool operator==(Key const&) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(Key const& key) const;
+    };
+
+    std::unordered_map<Key, Entry, KeyHash> entries;
+};
+
+} // miracle
+
+#endif // MIRACLEWM_KEY_BINDING_TABLE_H
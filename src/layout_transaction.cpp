@@ -0,0 +1,140 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "layout_transaction.h"
+#include "container.h"
+#include "parent_container.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+using namespace miracle;
+
+namespace
+{
+/// Holds containers in the order that they were first added, each of them once.
+template <typename T>
+struct DeferredList
+{
+    std::vector<std::weak_ptr<T>> items;
+
+    /// Maps a container to its position in [items].
+    std::unordered_map<T const*, size_t> index;
+
+    void add(std::shared_ptr<T> const& container)
+    {
+        auto it = index.find(container.get());
+        if (it != index.end())
+        {
+            // The address may have been reused by a new container since the old one was deferred
+            if (items[it->second].lock() == container)
+                return;
+
+            it->second = items.size();
+        }
+        else
+            index.emplace(container.get(), items.size());
+
+        items.push_back(container);
+    }
+
+    std::vector<std::weak_ptr<T>> take()
+    {
+        auto taken = std::move(items);
+        items.clear();
+        index.clear();
+        return taken;
+    }
+};
+
+struct TransactionState
+{
+    int depth = 0;
+    DeferredList<ParentContainer> layouts;
+    DeferredList<Container> commits;
+};
+
+thread_local TransactionState transaction_state;
+
+size_t get_depth(Container const& container)
+{
+    size_t depth = 0;
+    for (auto parent = container.get_parent().lock(); parent; parent = parent->get_parent().lock())
+        depth++;
+    return depth;
+}
+}
+
+LayoutTransaction::LayoutTransaction()
+{
+    transaction_state.depth++;
+}
+
+LayoutTransaction::~LayoutTransaction()
+{
+    if (--transaction_state.depth > 0)
+        return;
+
+    // The depth is now zero, so these layouts and commits go straight through. A commit
+    // may open and close a transaction of its own, hence we loop until nothing is left.
+    while (!transaction_state.layouts.items.empty() || !transaction_state.commits.items.empty())
+    {
+        apply_layouts();
+        for (auto const& weak_container : transaction_state.commits.take())
+        {
+            if (auto container = weak_container.lock())
+                container->commit_changes();
+        }
+    }
+}
+
+bool LayoutTransaction::is_active()
+{
+    return transaction_state.depth > 0;
+}
+
+void LayoutTransaction::defer_commit(std::shared_ptr<Container> const& container)
+{
+    transaction_state.commits.add(container);
+}
+
+void LayoutTransaction::defer_layout(std::shared_ptr<ParentContainer> const& parent)
+{
+    transaction_state.layouts.add(parent);
+}
+
+void LayoutTransaction::apply_layouts()
+{
+    std::vector<std::pair<size_t, std::shared_ptr<ParentContainer>>> parents;
+    for (auto const& weak_parent : transaction_state.layouts.take())
+    {
+        if (auto parent = weak_parent.lock())
+            parents.emplace_back(get_depth(*parent), parent);
+    }
+
+    // Laying out a parent also lays out the dirty parents beneath it, so those
+    // are clean by the time that they are reached
+    std::stable_sort(parents.begin(), parents.end(), [](auto const& a, auto const& b)
+    { return a.first < b.first; });
+
+    for (auto const& [depth, parent] : parents)
+    {
+        parent->apply_pending_layout();
+        transaction_state.commits.add(parent);
+    }
+}
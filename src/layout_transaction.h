@@ -0,0 +1,63 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLEWM_LAYOUT_TRANSACTION_H
+#define MIRACLEWM_LAYOUT_TRANSACTION_H
+
+#include <memory>
+
+namespace miracle
+{
+
+class Container;
+class ParentContainer;
+
+/// While a [LayoutTransaction] is alive, parents defer laying out their sub nodes
+/// and containers defer pushing their new geometry to the scene. When the outermost
+/// transaction ends, every dirty parent is laid out once and every deferred container
+/// is committed once, so that a batch of commands recalculates each layout and moves
+/// each window (and starts each animation) at most once.
+///
+/// Transactions nest and are tracked per thread, so a transaction opened on
+/// one thread never holds back commits that are made on another.
+class LayoutTransaction
+{
+public:
+    LayoutTransaction();
+    ~LayoutTransaction();
+    LayoutTransaction(LayoutTransaction const&) = delete;
+    LayoutTransaction& operator=(LayoutTransaction const&) = delete;
+
+    /// Returns true if a transaction is open on the calling thread.
+    static bool is_active();
+
+    /// Schedules [container] to be committed when the outermost transaction
+    /// ends. Scheduling the same container more than once commits it once.
+    static void defer_commit(std::shared_ptr<Container> const& container);
+
+    /// Schedules [parent] to be laid out when the outermost transaction ends.
+    static void defer_layout(std::shared_ptr<ParentContainer> const& parent);
+
+    /// Lays out the deferred parents now, outermost first, and schedules them to be
+    /// committed. Code that reads the areas of containers within a transaction
+    /// calls this first, so that it does not see the layout from before the batch.
+    static void apply_layouts();
+};
+
+} // miracle
+
+#endif // MIRACLEWM_LAYOUT_TRANSACTION_H
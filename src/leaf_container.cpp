@@ -19,6 +19,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "compositor_state.h"
 #include "config.h"
 #include "container_group_container.h"
+#include "container_snapshot.h"
+#include "layout_transaction.h"
 #include "output.h"
 #include "parent_container.h"
 #include "tiling_window_tree.h"
@@ -70,6 +72,7 @@ std::weak_ptr<ParentContainer> LeafContainer::get_parent() const
 void LeafContainer::set_parent(std::shared_ptr<ParentContainer> const& in_parent)
 {
     parent = in_parent;
+    advance_structure_generation();
 }
 
 void LeafContainer::set_state(MirWindowState state)
@@ -79,10 +82,17 @@ void LeafContainer::set_state(MirWindowState state)
 
 geom::Rectangle LeafContainer::get_visible_area() const
 {
-    // TODO: Could cache these half values in the config
-    int const half_gap_x = (int)(ceil((double)config->get_inner_gaps_x() / 2.0));
-    int const half_gap_y = (int)(ceil((double)config->get_inner_gaps_y() / 2.0));
-    auto neighbors = get_neighbors();
+    auto options = config->snapshot();
+    auto const generation = get_structure_generation();
+    bool const is_structure_cached = visible_area_cache && visible_area_cache->structure_generation == generation;
+    if (is_structure_cached
+        && visible_area_cache->options == options
+        && visible_area_cache->logical_area == logical_area)
+        return visible_area_cache->visible_area;
+
+    int const half_gap_x = (int)(ceil((double)options->inner_gaps_x / 2.0));
+    int const half_gap_y = (int)(ceil((double)options->inner_gaps_y / 2.0));
+    auto const neighbors = is_structure_cached ? visible_area_cache->neighbors : get_neighbors();
     int x = logical_area.top_left.x.as_int();
     int y = logical_area.top_left.y.as_int();
     int width = logical_area.size.width.as_int();
@@ -106,16 +116,24 @@ geom::Rectangle LeafContainer::get_visible_area() const
         height -= half_gap_y;
     }
 
-    int const border_size = config->get_border_config().size;
+    int const border_size = options->border_config.size;
     x += border_size;
     width -= 2 * border_size;
     y += border_size;
     height -= 2 * border_size;
 
-    return {
+    geom::Rectangle const visible_area {
         geom::Point { x,     y      },
         geom::Size { width, height }
     };
+    visible_area_cache = VisibleAreaCache {
+        .structure_generation = generation,
+        .options = std::move(options),
+        .logical_area = logical_area,
+        .neighbors = neighbors,
+        .visible_area = visible_area
+    };
+    return visible_area;
 }
 
 void LeafContainer::constrain()
@@ -240,24 +258,58 @@ bool LeafContainer::is_fullscreen() const
 
 void LeafContainer::commit_changes()
 {
-    if (next_state)
-    {
-        window_controller.change_state(window_, next_state.value());
-        constrain();
-        next_state.reset();
-    }
+    if (auto change = take_pending_change())
+        window_controller.apply({ &change.value(), 1 });
+}
+
+std::optional<PendingWindowChange> LeafContainer::take_pending_change()
+{
+    if (!next_state && !next_logical_area)
+        return std::nullopt;
 
-    if (next_logical_area)
+    PendingWindowChange change {
+        .window = window_,
+        .container = shared_from_this(),
+        .state = next_state
+    };
+    next_state.reset();
+
+    // The state is applied before the geometry, so it decides whether the window is fullscreen
+    bool const fullscreen = change.state
+        ? window_helpers::is_window_fullscreen(change.state.value())
+        : window_controller.is_fullscreen(window_);
+
+    // Only the geometry is deferred. State changes are applied straight away, as
+    // focus and visibility decisions made within the transaction depend on them.
+    bool moved = false;
+    if (next_logical_area && LayoutTransaction::is_active())
+        LayoutTransaction::defer_commit(shared_from_this());
+    else if (next_logical_area)
     {
-        auto previous = get_visible_area();
+        auto const previous = applied_visible_area.value_or(get_visible_area());
         logical_area = next_logical_area.value();
         next_logical_area.reset();
-        if (!window_controller.is_fullscreen(window_))
+
+        // The window is moved unless it already has this area. While it is fullscreen it
+        // is elsewhere, so the area is sent again once it is not.
+        auto const current = get_visible_area();
+        if (fullscreen)
+            applied_visible_area.reset();
+        else if (applied_visible_area != current)
         {
-            window_controller.set_rectangle(window_, previous, get_visible_area());
-            constrain();
+            change.rectangle = { previous, current };
+            applied_visible_area = current;
+            moved = true;
         }
     }
+
+    // A window that neither changed state nor moved has nothing to commit
+    if (!change.state && !moved)
+        return std::nullopt;
+
+    if (!fullscreen)
+        change.clip = get_visible_area();
+    return change;
 }
 
 void LeafContainer::handle_request_move(MirInputEvent const* input_event)
@@ -407,80 +459,30 @@ LayoutScheme LeafContainer::get_layout() const
     return LayoutScheme::none;
 }
 
-nlohmann::json LeafContainer::to_json() const
+void LeafContainer::snapshot(ContainerSnapshotBuffer& buffer) const
 {
+    auto const index = append_snapshot(buffer);
+    auto& snapshot = buffer[index];
     auto const app = window_.application();
-    auto const& win_info = window_controller.info_for(window_);
-    auto visible_area = get_visible_area();
-    auto workspace = get_workspace();
-    auto output = get_output();
-    auto locked_parent = parent.lock();
-    bool visible = true;
-
-    if (!output->is_active())
-        visible = false;
-
-    if (output->get_active_workspace_num() != workspace->get_workspace())
-        visible = false;
+    snapshot.name = app->name();
+    snapshot.app_id = window_controller.info_for(window_).application_id();
+    snapshot.pid = app->process_id();
+    snapshot.border_width = config->get_border_config().size;
 
+    // Only the focused sub node of a stacked or tabbed parent is shown
+    auto locked_parent = parent.lock();
     if (locked_parent == nullptr)
-        visible = false;
-
-    if (locked_parent->get_scheme() == LayoutScheme::stacking || locked_parent->get_scheme() == LayoutScheme::tabbing)
-        if (!is_focused())
-            visible = false;
-
-    nlohmann::json properties = nlohmann::json::object();
-    return {
-        { "id",                   reinterpret_cast<std::uintptr_t>(this)                                                                                                                                                                                                                        },
-        { "name",                 app->name()                                                                                                                                                                                                                                                   },
-        { "rect",                 {
-                      { "x", logical_area.top_left.x.as_int() },
-                      { "y", logical_area.top_left.y.as_int() },
-                      { "width", logical_area.size.width.as_int() },
-                      { "height", logical_area.size.height.as_int() },
-                  }                                                                                                                                                                                                                                                            },
-        { "focused",              is_focused()                                                                                                                                                                                                                                                  },
-        { "focus",                std::vector<int>()                                                                                                                                                                                                                                            },
-        { "border",               "normal"                                                                                                                                                                                                                                                      },
-        { "current_border_width", config->get_border_config().size                                                                                                                                                                                                                              },
-        { "layout",               "none"                                                                                                                                                                                                                                                        },
-        { "orientation",          "none"                                                                                                                                                                                                                                                        },
-        { "percent",              get_percent_of_parent()                                                                                                                                                                                                                                       },
-        { "window_rect",          {
-                                                                                                                                                                                                                                                                          { "x", visible_area.top_left.x.as_int() },
-                                                                                                                                                                                                                                                                          { "y", visible_area.top_left.y.as_int() },
-                                                                                                                                                                                                                                                                          { "width", visible_area.size.width.as_int() },
-                                                                                                                                                                                                                                                                          { "height", visible_area.size.height.as_int() },
-                                                                                                                                                                                                                                                                      } },
-        { "deco_rect",            {
-                           { "x", 0 },
-                           { "y", 0 },
-                           { "width", logical_area.size.width.as_int() },
-                           { "height", logical_area.size.height.as_int() },
-                       }                                                                                                                                                                                                                                                  },
-        { "geometry",             {
-                          { "x", 0 },
-                          { "y", 0 },
-                          { "width", logical_area.size.width.as_int() },
-                          { "height", logical_area.size.height.as_int() },
-                      }                                                                                                                                                                                                                                                    },
-        { "window",               0                                                                                                                                                                                                                                                             }, // TODO
-        { "urgent",               false                                                                                                                                                                                                                                                         },
-        { "floating_nodes",       std::vector<int>()                                                                                                                                                                                                                                            },
-        { "sticky",               false                                                                                                                                                                                                                                                         },
-        { "type",                 "con"                                                                                                                                                                                                                                                         },
-        { "fullscreen_mode",      is_fullscreen() ? 1 : 0                                                                                                                                                                                                                                       }, // TODO: Support value 2
-        { "pid",                  app->process_id()                                                                                                                                                                                                                                             },
-        { "app_id",               win_info.application_id()                                                                                                                                                                                                                                     },
-        { "visible",              visible                                                                                                                                                                                                                                                       },
-        { "shell",                "miracle-wm"                                                                                                                                                                                                                                                  }, // TODO
-        { "inhibit_idle",         false                                                                                                                                                                                                                                                         },
-        { "idle_inhibitors",      {
-                                                            { "application", "none" },
-                                                            { "user", "visible" },
-                                                        }                                                                                                                                                                                                           },
-        { "window_properties",    properties                                                                                                                                                                                                                                                    }, // TODO
-        { "nodes",                std::vector<int>()                                                                                                                                                                                                                                            }
-    };
-}
\ No newline at end of file
+        snapshot.visible = false;
+    else if (locked_parent->get_scheme() == LayoutScheme::stacking || locked_parent->get_scheme() == LayoutScheme::tabbing)
+    {
+        if (!snapshot.focused)
+            snapshot.visible = false;
+    }
+}
+
+nlohmann::json LeafContainer::to_json() const
+{
+    ContainerSnapshotBuffer buffer;
+    snapshot(buffer);
+    return miracle::to_json(buffer.get());
+}
@@ -31,6 +31,7 @@ namespace miracle
 {
 
 class MiracleConfig;
+struct ConfigDetails;
 class TilingWindowTree;
 class CompositorState;
 
@@ -78,6 +79,10 @@ public:
     [[nodiscard]] TilingWindowTree* get_tree() const { return tree; }
     [[nodiscard]] std::optional<miral::Window> window() const override { return window_; }
     void commit_changes() override;
+
+    /// Takes the state and geometry that have been set since the last commit, or nothing
+    /// if the window would not change. Geometry is left pending during a [LayoutTransaction].
+    [[nodiscard]] std::optional<PendingWindowChange> take_pending_change();
     void show() override;
     void hide() override;
     Workspace* get_workspace() const override;
@@ -99,11 +104,17 @@ public:
     bool set_layout(LayoutScheme) override;
     LayoutScheme get_layout() const override;
     nlohmann::json to_json() const override;
+    void snapshot(ContainerSnapshotBuffer& buffer) const override;
 
 private:
     WindowController& window_controller;
     geom::Rectangle logical_area;
     std::optional<geom::Rectangle> next_logical_area;
+
+    /// The visible area that was last sent to the window. The visible area depends on the
+    /// gaps and borders in the config, so it can change while the logical area does not.
+    std::optional<geom::Rectangle> applied_visible_area;
+
     std::shared_ptr<MiracleConfig> config;
     TilingWindowTree* tree;
     miral::Window window_;
@@ -115,6 +126,18 @@ private:
     LayoutScheme tentative_direction = LayoutScheme::none;
     glm::mat4 transform = glm::mat4(1.f);
     uint32_t animation_handle_ = 0;
+
+    /// The inputs that [visible_area] was computed from. The neighbors only depend on
+    /// the shape of the tree, so they survive a change to the area or the config.
+    struct VisibleAreaCache
+    {
+        uint64_t structure_generation;
+        std::shared_ptr<ConfigDetails const> options;
+        geom::Rectangle logical_area;
+        std::array<bool, (size_t)Direction::MAX> neighbors;
+        geom::Rectangle visible_area;
+    };
+    mutable std::optional<VisibleAreaCache> visible_area_cache;
 };
 
 } // miracle
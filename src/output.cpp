@@ -23,8 +23,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "compositor_state.h"
 #include "floating_window_container.h"
 #include "leaf_container.h"
+#include "parent_container.h"
+#include "tiling_window_tree.h"
 #include "vector_helpers.h"
 #include "window_helpers.h"
+#include "window_index.h"
 
 #include "workspace.h"
 #include "workspace_manager.h"
@@ -71,7 +74,7 @@ std::shared_ptr<Workspace> const& Output::get_active_workspace() const
     throw std::runtime_error("get_active_workspace: unable to find the active workspace. We shouldn't be here!");
 }
 
-std::shared_ptr<Container> Output::intersect(const MirPointerEvent* event)
+std::shared_ptr<Container> Output::intersect(const MirPointerEvent* event, WindowIndex const& window_index)
 {
     if (get_active_workspace_num() < 0)
     {
@@ -81,6 +84,30 @@ std::shared_ptr<Container> Output::intersect(const MirPointerEvent* event)
 
     auto x = miral::toolkit::mir_pointer_event_axis_value(event, MirPointerAxis::mir_pointer_axis_x);
     auto y = miral::toolkit::mir_pointer_event_axis_value(event, MirPointerAxis::mir_pointer_axis_y);
+
+    // When nothing is stacked above the tiled windows at the pointer, the tree answers
+    // without walking the scene. Shell components, such as dialogs, menus and panels,
+    // and windows without a container may be stacked anywhere, so the scene is asked
+    // whenever one of them is under the pointer.
+    geom::Point const point((int)x, (int)y);
+    auto const is_under_pointer = [&](miral::Window const& window)
+    {
+        return geom::Rectangle(window.top_left(), window.size()).contains(point);
+    };
+
+    auto const& workspace = get_active_workspace();
+    auto const* tree = workspace->get_tree();
+    if (state.active
+        && state.active->get_type() == ContainerType::leaf
+        && !workspace->has_floating_containers()
+        && !tree->has_fullscreen_window()
+        && !window_index.any_of_type(ContainerType::shell, is_under_pointer)
+        && !window_index.any_of_type(ContainerType::none, is_under_pointer))
+    {
+        if (auto leaf = tree->get_root()->find_leaf_at(point))
+            return leaf;
+    }
+
     if (auto const window = tools.window_at({ x, y }))
         return window_controller.get_container(window);
 
@@ -287,9 +314,9 @@ std::vector<miral::Window> Output::collect_all_windows() const
     std::vector<miral::Window> windows;
     for (auto& workspace : get_workspaces())
     {
-        workspace->for_each_window([&](std::shared_ptr<Container> const& container)
+        workspace->for_each_window([&](Container& container)
         {
-            if (auto window = container->window())
+            if (auto window = container.window())
                 windows.push_back(*window);
         });
     }
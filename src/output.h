@@ -36,6 +36,7 @@ class MiracleConfig;
 class WindowManagerToolsWindowController;
 class CompositorState;
 class Animator;
+class WindowIndex;
 
 class Output
 {
@@ -52,7 +53,9 @@ public:
         Animator&);
     ~Output() = default;
 
-    std::shared_ptr<Container> intersect(MirPointerEvent const* event);
+    /// Returns the container under the pointer. [window_index] is used to find the
+    /// shell components, such as dialogs and menus, that may be stacked above the tiles.
+    std::shared_ptr<Container> intersect(MirPointerEvent const* event, WindowIndex const& window_index);
     AllocationHint allocate_position(
         miral::ApplicationInfo const& app_info,
         miral::WindowSpecification& requested_specification,
@@ -20,10 +20,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "compositor_state.h"
 #include "config.h"
 #include "container.h"
+#include "container_snapshot.h"
+#include "layout_transaction.h"
 #include "leaf_container.h"
 #include "output.h"
 #include "tiling_window_tree.h"
 #include "workspace.h"
+#include <algorithm>
 #include <cmath>
 #include <mir/log.h>
 
@@ -31,57 +34,21 @@ using namespace miracle;
 
 namespace
 {
-struct InsertNodeInternalResult
+/// Scales [weights] so that they sum to 1.
+void normalize(std::vector<double>& weights)
 {
-    int size;
-    int position;
-};
+    double total = 0;
+    for (auto weight : weights)
+        total += weight;
 
-InsertNodeInternalResult insert_node_internal(
-    int lane_size,
-    int lane_pos,
-    int index,
-    size_t node_count,
-    std::function<int(int)> const& get_node_size,
-    std::function<void(int, int, int)> const& set_node_size_position)
-{
-    int new_item_size = floor((double)lane_size / (double)(node_count + 1));
-    int new_item_position = lane_pos + index * new_item_size;
-
-    int size_lost = 0;
-    int prev_pos = lane_pos;
-    int prev_size = 0;
-    for (int i = 0; i < node_count; i++)
+    if (total <= 0)
     {
-        int node_size = get_node_size(i);
-
-        // Each node will lose a percentage of its width that corresponds to what it can give
-        // (meaning that larger nodes give more width, and lesser nodes give less width)
-        double percent_size_lost = ((double)node_size / (double)lane_size);
-        int width_to_lose = (int)floor(percent_size_lost * new_item_size);
-        size_lost += width_to_lose;
-
-        if (i == index)
-        {
-            prev_size = new_item_size;
-            prev_pos = new_item_position;
-        }
-
-        int changed_node_size = node_size - width_to_lose;
-        int changed_node_pos = prev_pos + prev_size;
-        set_node_size_position(i, changed_node_size, changed_node_pos);
-
-        prev_pos = changed_node_pos;
-        prev_size = changed_node_size;
+        std::fill(weights.begin(), weights.end(), 1.0 / (double)weights.size());
+        return;
     }
 
-    if (node_count)
-    {
-        new_item_size += size_lost - new_item_size;
-        new_item_position -= size_lost - new_item_size;
-    }
-
-    return { new_item_size, new_item_position };
+    for (auto& weight : weights)
+        weight /= total;
 }
 }
 
@@ -135,85 +102,27 @@ geom::Rectangle ParentContainer::create_space(int pending_index)
     //  selected window if it wants to be a lane. If it does, we
     //  will grant its request and create a new lane.
 
-    auto placement_area = get_logical_area();
-    geom::Rectangle pending_logical_rect;
-    if (scheme == LayoutScheme::horizontal)
-    {
-        auto result = insert_node_internal(
-            placement_area.size.width.as_int(),
-            placement_area.top_left.x.as_int(),
-            pending_index,
-            sub_nodes.size(),
-            [&](int index)
-        { return sub_nodes[index]->get_logical_area().size.width.as_int(); },
-            [&](int index, int size, int pos)
-        {
-            sub_nodes[index]->set_logical_area({
-                geom::Point {
-                             pos,
-                             placement_area.top_left.y.as_int()  },
-                geom::Size {
-                             size,
-                             placement_area.size.height.as_int() }
-            });
-        });
-        geom::Rectangle new_node_logical_rect = {
-            geom::Point {
-                         result.position,
-                         placement_area.top_left.y.as_int()  },
-            geom::Size {
-                         result.size,
-                         placement_area.size.height.as_int() }
-        };
-        pending_logical_rect = new_node_logical_rect;
-    }
-    else if (scheme == LayoutScheme::vertical)
-    {
-        auto result = insert_node_internal(
-            placement_area.size.height.as_int(),
-            placement_area.top_left.y.as_int(),
-            pending_index,
-            sub_nodes.size(),
-            [&](int index)
-        { return sub_nodes[index]->get_logical_area().size.height.as_int(); },
-            [&](int index, int size, int pos)
-        {
-            sub_nodes[index]->set_logical_area({
-                geom::Point {
-                             placement_area.top_left.x.as_int(),
-                             pos  },
-                geom::Size {
-                             placement_area.size.width.as_int(),
-                             size }
-            });
-        });
-        geom::Rectangle new_node_logical_rect = {
-            geom::Point {
-                         placement_area.top_left.x.as_int(),
-                         result.position },
-            geom::Size {
-                         placement_area.size.width.as_int(),
-                         result.size     }
-        };
-        pending_logical_rect = new_node_logical_rect;
-    }
-    else if (scheme == LayoutScheme::tabbing || scheme == LayoutScheme::stacking)
-    {
-        pending_logical_rect = placement_area;
-    }
-    else
-    {
-        mir::fatal_error("Invalid scheme during create_space");
-    }
+    // The new node takes an even share, and every other node gives up space in
+    // proportion to its size
+    auto const count = (double)weights.size();
+    for (auto& weight : weights)
+        weight *= count / (count + 1);
+    weights.insert(weights.begin() + pending_index, 1.0 / (count + 1));
+    advance_structure_generation();
+
+    auto const areas = calculate_areas(get_logical_area());
+    for (size_t i = 0; i < sub_nodes.size(); i++)
+        sub_nodes[i]->set_logical_area(areas[i < (size_t)pending_index ? i : i + 1]);
 
-    return pending_logical_rect;
+    laid_out_area = get_logical_area();
+    return areas[pending_index];
 }
 
 std::shared_ptr<LeafContainer> ParentContainer::create_space_for_window(int pending_index)
 {
     if (pending_index < 0)
         pending_index = num_nodes();
-    pending_node = std::make_shared<LeafContainer>(
+    pending_node = make_container<LeafContainer>(
         node_interface,
         create_space(pending_index),
         config,
@@ -221,6 +130,7 @@ std::shared_ptr<LeafContainer> ParentContainer::create_space_for_window(int pend
         as_parent(shared_from_this()),
         state);
     sub_nodes.insert(sub_nodes.begin() + pending_index, pending_node);
+    reindex(pending_index);
     return pending_node;
 }
 
@@ -246,6 +156,7 @@ void ParentContainer::graft_existing(std::shared_ptr<Container> const& node, int
     node->set_parent(as_parent(shared_from_this()));
     node->set_logical_area(rectangle);
     sub_nodes.insert(sub_nodes.begin() + index, node);
+    reindex(index);
     relayout();
     constrain();
 }
@@ -259,7 +170,7 @@ std::shared_ptr<ParentContainer> ParentContainer::convert_to_parent(std::shared_
         return nullptr;
     }
 
-    auto new_parent_node = std::make_shared<ParentContainer>(
+    auto new_parent_node = make_container<ParentContainer>(
         node_interface,
         container->get_logical_area(),
         config,
@@ -267,127 +178,125 @@ std::shared_ptr<ParentContainer> ParentContainer::convert_to_parent(std::shared_
         Container::as_parent(shared_from_this()),
         state);
     new_parent_node->sub_nodes.push_back(container);
+    new_parent_node->weights.push_back(1.0);
+    new_parent_node->laid_out_area = new_parent_node->get_logical_area();
+    new_parent_node->reindex();
     container->set_parent(new_parent_node);
+    advance_structure_generation();
     sub_nodes[index] = new_parent_node;
+    new_parent_node->index_in_parent = index;
+
+    // Focus stays where it was, now one level deeper
+    if (focused_child.lock() == container)
+    {
+        focused_child = new_parent_node;
+        new_parent_node->focused_child = container;
+    }
     return new_parent_node;
 }
 
 void ParentContainer::set_logical_area(const geom::Rectangle& target_rect)
 {
-    // We are setting the size of the lane, but each window might have an idea of how
-    // its own height relates to the lane (e.g. I take up 300px of 900px lane while my
-    // neighbor takes up the remaining 600px, horizontally).
-    // We need to look at the target dimension and scale everyone relative to that.
-    // However, the "non-main-axis" dimension will be consistent across each node.
-    auto current_logical_area = get_logical_area();
     logical_area = target_rect;
-    auto target_placement_area = get_logical_area();
-    std::vector<geom::Rectangle> pending_size_updates;
-    pending_size_updates.reserve(sub_nodes.size());
-    if (scheme == LayoutScheme::horizontal)
+
+    // The areas of the sub nodes only depend on the placement area and the weights,
+    // so nothing beneath this node changes unless one of them has.
+    auto const placement_area = get_logical_area();
+    if (!is_layout_dirty && laid_out_area == placement_area)
+        return;
+
+    is_layout_dirty = false;
+    laid_out_area = placement_area;
+    auto const areas = calculate_areas(placement_area);
+    for (size_t i = 0; i < sub_nodes.size(); i++)
+        sub_nodes[i]->set_logical_area(areas[i]);
+}
+
+void ParentContainer::invalidate_layout()
+{
+    is_layout_dirty = true;
+    for (auto const& node : sub_nodes)
     {
-        int total_width = 0;
-        for (size_t idx = 0; idx < sub_nodes.size(); idx++)
-        {
-            auto item = sub_nodes[idx];
-            auto item_rect = item->get_logical_area();
-            double percent_width_taken = (double)item_rect.size.width.as_int() / (double)current_logical_area.size.width.as_int();
-            int new_width = (int)ceil((double)target_placement_area.size.width.as_int() * percent_width_taken);
-
-            geom::Rectangle new_item_rect;
-            new_item_rect.size = geom::Size {
-                geom::Width { new_width },
-                target_placement_area.size.height
-            };
-            if (idx == 0)
-            {
-                new_item_rect.top_left = geom::Point {
-                    target_placement_area.top_left.x,
-                    target_placement_area.top_left.y
-                };
-            }
-            else
-            {
-                auto const& prev_rect = pending_size_updates[idx - 1];
-                new_item_rect.top_left = geom::Point {
-                    geom::X { prev_rect.top_left.x.as_int() + prev_rect.size.width.as_int() },
-                    target_placement_area.top_left.y
-                };
-            }
-
-            pending_size_updates.push_back(new_item_rect);
-            total_width += new_width;
-        }
+        if (auto const lane = Container::as_parent(node))
+            lane->invalidate_layout();
+    }
+}
 
-        if (!pending_size_updates.empty())
-        {
-            int leftover_width = target_placement_area.size.width.as_int() - total_width;
-            pending_size_updates.back().size.width = geom::Width { pending_size_updates.back().size.width.as_int() + leftover_width };
-        }
+std::vector<geom::Rectangle> ParentContainer::calculate_areas(geom::Rectangle const& placement_area) const
+{
+    std::vector<geom::Rectangle> areas;
+    if (scheme != LayoutScheme::horizontal && scheme != LayoutScheme::vertical)
+    {
+        if (scheme != LayoutScheme::tabbing && scheme != LayoutScheme::stacking)
+            mir::log_error("Cannot calculate the areas of the sub nodes with an invalid scheme");
+
+        areas.assign(weights.size(), placement_area);
+        return areas;
     }
-    else if (scheme == LayoutScheme::vertical)
+
+    bool const is_horizontal = scheme == LayoutScheme::horizontal;
+    int const start = is_horizontal ? placement_area.top_left.x.as_int() : placement_area.top_left.y.as_int();
+    int const length = is_horizontal ? placement_area.size.width.as_int() : placement_area.size.height.as_int();
+
+    // Each edge is rounded from the running total of the weights rather than from the
+    // previous edge, so rounding errors cannot accumulate along the lane
+    areas.reserve(weights.size());
+    double cumulative_weight = 0;
+    int edge = start;
+    for (size_t i = 0; i < weights.size(); i++)
     {
-        int total_height = 0;
-        for (size_t idx = 0; idx < sub_nodes.size(); idx++)
-        {
-            auto item = sub_nodes[idx];
-            auto item_rect = item->get_logical_area();
-            double percent_height_taken = static_cast<double>(item_rect.size.height.as_int()) / current_logical_area.size.height.as_int();
-            int new_height = (int)floor((double)target_placement_area.size.height.as_int() * percent_height_taken);
-
-            geom::Rectangle new_item_rect;
-            new_item_rect.size = geom::Size {
-                target_placement_area.size.width,
-                geom::Height { new_height },
-            };
-            if (idx == 0)
-            {
-                new_item_rect.top_left = geom::Point {
-                    target_placement_area.top_left.x,
-                    target_placement_area.top_left.y
-                };
-            }
-            else
-            {
-                auto const& prev_rect = pending_size_updates[idx - 1];
-                new_item_rect.top_left = geom::Point {
-                    target_placement_area.top_left.x,
-                    geom::Y { prev_rect.top_left.y.as_int() + prev_rect.size.height.as_int() },
-                };
-            }
-
-            pending_size_updates.push_back(new_item_rect);
-            total_height += new_height;
-        }
+        cumulative_weight += weights[i];
+        int const next_edge = i == weights.size() - 1
+            ? start + length
+            : start + (int)std::lround(cumulative_weight * length);
 
-        if (!pending_size_updates.empty())
+        if (is_horizontal)
         {
-            int leftover_height = target_placement_area.size.height.as_int() - total_height;
-            pending_size_updates.back().size.height = geom::Height { pending_size_updates.back().size.height.as_int() + leftover_height };
+            areas.push_back({
+                geom::Point { edge,             placement_area.top_left.y.as_int()  },
+                geom::Size { next_edge - edge, placement_area.size.height.as_int() }
+            });
         }
-    }
-    else if (scheme == LayoutScheme::tabbing || scheme == LayoutScheme::stacking)
-    {
-        for (size_t idx = 0; idx < sub_nodes.size(); idx++)
+        else
         {
-            pending_size_updates.push_back(target_placement_area);
+            areas.push_back({
+                geom::Point { placement_area.top_left.x.as_int(), edge             },
+                geom::Size { placement_area.size.width.as_int(), next_edge - edge }
+            });
         }
-    }
-    else
-    {
-        mir::log_error("Cannot set_logical_area with invalid scheme");
+
+        edge = next_edge;
     }
 
-    for (size_t i = 0; i < sub_nodes.size(); i++)
+    return areas;
+}
+
+void ParentContainer::set_sizes(std::vector<int> const& sizes)
+{
+    if (sizes.size() != weights.size())
     {
-        sub_nodes[i]->set_logical_area(pending_size_updates[i]);
+        mir::log_error("set_sizes: expected %zu sizes but received %zu", weights.size(), sizes.size());
+        return;
     }
+
+    weights.assign(sizes.begin(), sizes.end());
+    normalize(weights);
+    relayout();
 }
 
 void ParentContainer::commit_changes()
 {
-    for (auto& node : sub_nodes)
-        node->commit_changes();
+    // Every changed window beneath this node reaches the window manager in one batch,
+    // and windows that did not change are left alone
+    std::vector<PendingWindowChange> changes;
+    for_each_leaf([&](LeafContainer& leaf)
+    {
+        if (auto change = leaf.take_pending_change())
+            changes.push_back(std::move(change.value()));
+    });
+
+    if (!changes.empty())
+        node_interface.apply(changes);
 }
 
 std::shared_ptr<Container> ParentContainer::at(size_t i) const
@@ -406,22 +315,92 @@ std::shared_ptr<LeafContainer> ParentContainer::get_nth_window(size_t i) const
     if (sub_nodes[i]->is_leaf())
         return as_leaf(sub_nodes[i]);
 
-    // The lane is correct, so let's get the first window in that lane.
-    return as_parent(sub_nodes[i])->get_nth_window(0);
+    // The lane is correct, so let's get the window that was last focused in that lane.
+    return as_parent(sub_nodes[i])->get_focused_leaf();
 }
 
-std::shared_ptr<Container> ParentContainer::find_where(std::function<bool(std::shared_ptr<Container> const&)> func) const
+void ParentContainer::set_focused_child(std::shared_ptr<Container> const& child)
 {
-    for (auto node : sub_nodes)
-        if (func(node))
-            return node;
+    focused_child = child;
+}
 
-    for (auto const& node : sub_nodes)
+std::shared_ptr<Container> ParentContainer::get_focused_child() const
+{
+    auto child = focused_child.lock();
+    if (!child || get_index_of_node(child) < 0)
+        return nullptr;
+
+    return child;
+}
+
+std::shared_ptr<LeafContainer> ParentContainer::get_focused_leaf() const
+{
+    ParentContainer const* current = this;
+    while (!current->sub_nodes.empty())
     {
-        if (node->is_lane())
+        auto next = current->get_focused_child();
+        if (!next)
+            next = current->sub_nodes.front();
+
+        if (auto leaf = as_leaf(next))
+            return leaf;
+
+        current = dynamic_cast<ParentContainer const*>(next.get());
+        if (!current)
+            return nullptr;
+    }
+
+    return nullptr;
+}
+
+void ParentContainer::reindex(size_t first)
+{
+    for (size_t i = first; i < sub_nodes.size(); i++)
+        sub_nodes[i]->index_in_parent = (int)i;
+}
+
+std::shared_ptr<LeafContainer> ParentContainer::find_leaf_at(geom::Point const& point) const
+{
+    ParentContainer const* current = this;
+    while (current)
+    {
+        auto const& nodes = current->sub_nodes;
+        auto hit = nodes.end();
+        if (current->scheme == LayoutScheme::horizontal || current->scheme == LayoutScheme::vertical)
+        {
+            bool const is_horizontal = current->scheme == LayoutScheme::horizontal;
+            int const coordinate = is_horizontal ? point.x.as_int() : point.y.as_int();
+            hit = std::partition_point(nodes.begin(), nodes.end(), [&](std::shared_ptr<Container> const& node)
+            {
+                auto const area = node->get_logical_area();
+                auto const end = is_horizontal
+                    ? area.top_left.x.as_int() + area.size.width.as_int()
+                    : area.top_left.y.as_int() + area.size.height.as_int();
+                return end <= coordinate;
+            });
+        }
+        else if (!nodes.empty())
+        {
+            // Every tab shares the same area, but only the shown one can be under the point
+            auto const shown = current->get_focused_child();
+            hit = shown ? nodes.begin() + shown->get_index_in_parent() : nodes.begin();
+        }
+
+        if (hit == nodes.end() || !(*hit)->get_logical_area().contains(point))
+            return nullptr;
+
+        switch ((*hit)->get_type())
         {
-            if (auto retval = as_parent(node)->find_where(func))
-                return retval;
+        case ContainerType::leaf:
+            // The logical area includes the gaps around the window, which belong to no window
+            if (!(*hit)->get_visible_area().contains(point))
+                return nullptr;
+            return std::static_pointer_cast<LeafContainer>(*hit);
+        case ContainerType::parent:
+            current = static_cast<ParentContainer const*>(hit->get());
+            break;
+        default:
+            return nullptr;
         }
     }
 
@@ -439,18 +418,24 @@ void ParentContainer::swap_nodes(std::shared_ptr<Container> const& first, std::s
     auto second_index = get_index_of_node(second);
     sub_nodes[second_index] = first;
     sub_nodes[first_index] = second;
+    first->index_in_parent = second_index;
+    second->index_in_parent = first_index;
+    std::swap(weights[first_index], weights[second_index]);
     relayout();
     constrain();
 }
 
 void ParentContainer::remove(const std::shared_ptr<Container>& node)
 {
-    sub_nodes.erase(
-        std::remove_if(sub_nodes.begin(), sub_nodes.end(), [&](std::shared_ptr<Container> const& content)
-    {
-        return content == node;
-    }),
-        sub_nodes.end());
+    auto index = get_index_of_node(node);
+    if (index < 0)
+        return;
+
+    sub_nodes.erase(sub_nodes.begin() + index);
+    weights.erase(weights.begin() + index);
+    normalize(weights);
+    node->index_in_parent = -1;
+    reindex(index);
 
     // If we have one child AND it is a lane, THEN we can absorb all of it's children
     if (sub_nodes.size() == 1 && sub_nodes[0]->is_lane())
@@ -462,7 +447,10 @@ void ParentContainer::remove(const std::shared_ptr<Container>& node)
             sub_nodes.push_back(sub_node);
             sub_node->set_parent(as_parent(shared_from_this()));
         }
+        weights = dying_lane->weights;
+        focused_child = dying_lane->focused_child;
         set_layout(dying_lane->get_direction());
+        reindex();
     }
 
     relayout();
@@ -470,11 +458,15 @@ void ParentContainer::remove(const std::shared_ptr<Container>& node)
 
 int ParentContainer::get_index_of_node(miracle::Container const* node) const
 {
-    for (int i = 0; i < sub_nodes.size(); i++)
-        if (sub_nodes[i].get() == node)
-            return i;
+    if (!node)
+        return -1;
+
+    // Each node knows its own index, which only has to be checked against this parent
+    auto const index = node->index_in_parent;
+    if (index < 0 || index >= (int)sub_nodes.size() || sub_nodes[index].get() != node)
+        return -1;
 
-    return -1;
+    return index;
 }
 
 int ParentContainer::get_index_of_node(std::shared_ptr<Container> const& node) const
@@ -484,7 +476,7 @@ int ParentContainer::get_index_of_node(std::shared_ptr<Container> const& node) c
 
 int ParentContainer::get_index_of_node(Container const& node) const
 {
-    return get_index_of_node(node.shared_from_this().get());
+    return get_index_of_node(&node);
 }
 
 void ParentContainer::constrain()
@@ -517,61 +509,31 @@ std::weak_ptr<ParentContainer> ParentContainer::get_parent() const
 void ParentContainer::set_parent(std::shared_ptr<ParentContainer> const& in_parent)
 {
     parent = in_parent;
+    advance_structure_generation();
 }
 
 void ParentContainer::relayout()
 {
-    auto placement_area = get_logical_area();
-    if (scheme == LayoutScheme::horizontal)
-    {
-        int total_width = 0;
-        for (auto const& node : sub_nodes)
-        {
-            total_width += node->get_logical_area().size.width.as_int();
-        }
-
-        int diff_width = placement_area.size.width.as_value() - total_width;
-        int diff_per_node = floor((double)diff_width / (double)sub_nodes.size());
-        for (auto const& node : sub_nodes)
-        {
-            auto rectangle = node->get_logical_area();
-            rectangle.size.width = geom::Width { rectangle.size.width.as_int() + diff_per_node };
-            rectangle.size.height = geom::Height { placement_area.size.height };
-            node->set_logical_area(rectangle);
-        }
-    }
-    else if (scheme == LayoutScheme::vertical)
-    {
-        int total_height = 0;
-        for (auto const& node : sub_nodes)
-        {
-            total_height += node->get_logical_area().size.height.as_int();
-        }
+    // Note that it is important to use the logical_area here instead of the placement area
+    is_layout_dirty = true;
+    advance_structure_generation();
 
-        int diff_width = placement_area.size.height.as_value() - total_height;
-        int diff_per_node = floor((double)diff_width / (double)sub_nodes.size());
-        for (auto const& node : sub_nodes)
-        {
-            auto rectangle = node->get_logical_area();
-            rectangle.size.width = geom::Width { placement_area.size.width };
-            rectangle.size.height = geom::Height { rectangle.size.height.as_int() + diff_per_node };
-            node->set_logical_area(rectangle);
-        }
-    }
-    else if (scheme == LayoutScheme::tabbing || scheme == LayoutScheme::stacking)
+    // Within a transaction, the parent is laid out once when it ends however often it changes
+    if (LayoutTransaction::is_active())
     {
-        for (auto const& node : sub_nodes)
-            node->set_logical_area(placement_area);
-    }
-    else
-    {
-        mir::log_error("Invalid scheme during relayout");
+        LayoutTransaction::defer_layout(as_parent(shared_from_this()));
+        return;
     }
 
-    // Note that it is important to use the logical_area here instead of the placement area
     set_logical_area(logical_area);
 }
 
+void ParentContainer::apply_pending_layout()
+{
+    if (is_layout_dirty)
+        set_logical_area(logical_area);
+}
+
 void ParentContainer::handle_ready()
 {
 }
@@ -800,73 +762,29 @@ LayoutScheme ParentContainer::get_layout() const
     return scheme;
 }
 
+void ParentContainer::snapshot(ContainerSnapshotBuffer& buffer) const
+{
+    auto const index = append_snapshot(buffer);
+    {
+        auto& snapshot = buffer[index];
+        snapshot.name = "Parent #" + std::to_string(snapshot.id);
+        snapshot.layout = scheme;
+        if (parent.expired())
+            snapshot.visible = false;
+    }
+
+    for (auto const& node : sub_nodes)
+        node->snapshot(buffer);
+
+    // The buffer may have grown while the sub nodes were appended
+    auto& snapshot = buffer[index];
+    snapshot.child_count = static_cast<uint32_t>(sub_nodes.size());
+    snapshot.descendant_count = static_cast<uint32_t>(buffer.size() - index - 1);
+}
+
 nlohmann::json ParentContainer::to_json() const
 {
-    auto const visible_area = get_visible_area();
-    auto const logical_area = get_logical_area();
-    nlohmann::json containers_json;
-    for (auto const& container : sub_nodes)
-
-        containers_json.push_back(container->to_json());
-    auto workspace = get_workspace();
-    auto output = get_output();
-    auto locked_parent = parent.lock();
-    bool visible = true;
-    if (!output->is_active())
-        visible = false;
-
-    if (output->get_active_workspace_num() != workspace->get_workspace())
-        visible = false;
-
-    if (locked_parent == nullptr)
-        visible = false;
-
-    auto const id = reinterpret_cast<std::uintptr_t>(this);
-    return {
-        { "id",                   id                                                                                                                                                                                                                                      },
-        { "name",                 "Parent #" + std::to_string(id)                                                                                                                                                                                                         },
-        { "rect",                 {
-                      { "x", logical_area.top_left.x.as_int() },
-                      { "y", logical_area.top_left.y.as_int() },
-                      { "width", logical_area.size.width.as_int() },
-                      { "height", logical_area.size.height.as_int() },
-                  }                                                                                                                                                                                                                                      },
-        { "focused",              is_focused()                                                                                                                                                                                                                            },
-        { "focus",                std::vector<int>()                                                                                                                                                                                                                      },
-        { "border",               "none"                                                                                                                                                                                                                                  },
-        { "current_border_width", 0                                                                                                                                                                                                                                       },
-        { "layout",               to_string(scheme)                                                                                                                                                                                                                       },
-        { "orientation",          "none"                                                                                                                                                                                                                                  },
-        { "percent",              get_percent_of_parent()                                                                                                                                                                                                                 },
-        { "window_rect",          {
-                                                                                                                                                                                                                                                    { "x", visible_area.top_left.x.as_int() },
-                                                                                                                                                                                                                                                    { "y", visible_area.top_left.y.as_int() },
-                                                                                                                                                                                                                                                    { "width", visible_area.size.width.as_int() },
-                                                                                                                                                                                                                                                    { "height", visible_area.size.height.as_int() },
-                                                                                                                                                                                                                                                } },
-        { "deco_rect",            {
-                           { "x", 0 },
-                           { "y", 0 },
-                           { "width", logical_area.size.width.as_int() },
-                           { "height", logical_area.size.height.as_int() },
-                       }                                                                                                                                                                                                                            },
-        { "geometry",             {
-                          { "x", 0 },
-                          { "y", 0 },
-                          { "width", logical_area.size.width.as_int() },
-                          { "height", logical_area.size.height.as_int() },
-                      }                                                                                                                                                                                                                              },
-        { "window",               0                                                                                                                                                                                                                                       }, // TODO
-        { "urgent",               false                                                                                                                                                                                                                                   },
-        { "floating_nodes",       std::vector<int>()                                                                                                                                                                                                                      },
-        { "sticky",               false                                                                                                                                                                                                                                   },
-        { "type",                 "con"                                                                                                                                                                                                                                   },
-        { "fullscreen_mode",      is_fullscreen() ? 1 : 0                                                                                                                                                                                                                 }, // TODO: Support value 2
-        { "visible",              visible                                                                                                                                                                                                                                 },
-        { "shell",                "miracle-wm"                                                                                                                                                                                                                            }, // TODO
-        { "inhibit_idle",         false                                                                                                                                                                                                                                   },
-        { "idle_inhibitors",      {}                                                                                                                                                                                                                                      },
-        { "window_properties",    {}                                                                                                                                                                                                                                      }, // TODO
-        { "nodes",                containers_json                                                                                                                                                                                                                         }
-    };
-}
\ No newline at end of file
+    ContainerSnapshotBuffer buffer;
+    snapshot(buffer);
+    return miracle::to_json(buffer.get());
+}
@@ -20,8 +20,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "container.h"
 #include "layout_scheme.h"
+#include "leaf_container.h"
 #include "window_controller.h"
+#include <functional>
 #include <mir/geometry/rectangle.h>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 namespace geom = mir::geometry;
 
@@ -33,6 +38,30 @@ class MiracleConfig;
 class TilingWindowTree;
 class CompositorState;
 
+/// Whether a parent is visited before or after the containers beneath it.
+enum class TraversalOrder
+{
+    pre,
+    post
+};
+
+namespace detail
+{
+/// Calls [f] with [container]. A visitor may return a bool, in which case true
+/// stops the traversal. Visitors that return nothing always continue.
+template <typename F, typename T>
+bool visit(F& f, T& container)
+{
+    if constexpr (std::is_same_v<std::invoke_result_t<F&, T&>, bool>)
+        return std::invoke(f, container);
+    else
+    {
+        std::invoke(f, container);
+        return false;
+    }
+}
+}
+
 /// A parent container defines the layout of containers beneath it.
 /// The container
 class ParentContainer : public Container
@@ -52,12 +81,47 @@ public:
     void graft_existing(std::shared_ptr<Container> const& node, int index);
     std::shared_ptr<ParentContainer> convert_to_parent(std::shared_ptr<Container> const& container);
     void set_logical_area(geom::Rectangle const& target_rect) override;
+    /// Makes the next [set_logical_area] lay out this node and every parent beneath it,
+    /// even if their placement areas are unchanged. Needed when the gaps or borders change.
+    void invalidate_layout();
+    /// Lays out the sub nodes if a change to this node has not been laid out yet,
+    /// as happens when the change was made during a [LayoutTransaction].
+    void apply_pending_layout();
+    /// Shares the main axis between the sub nodes in proportion to [sizes], which
+    /// holds one entry per sub node.
+    void set_sizes(std::vector<int> const& sizes);
     void swap_nodes(std::shared_ptr<Container> const& first, std::shared_ptr<Container> const& second);
     void remove(std::shared_ptr<Container> const& node);
     void commit_changes() override;
     std::shared_ptr<Container> at(size_t i) const;
+    /// Returns the leaf at [i], or the leaf that was last focused within the sub node at [i].
     std::shared_ptr<LeafContainer> get_nth_window(size_t i) const;
-    std::shared_ptr<Container> find_where(std::function<bool(std::shared_ptr<Container> const&)> func) const;
+
+    /// Records that focus is now within [child], which must be one of the sub nodes.
+    void set_focused_child(std::shared_ptr<Container> const& child);
+
+    /// Returns the sub node that focus was last within, if it is still a sub node.
+    [[nodiscard]] std::shared_ptr<Container> get_focused_child() const;
+
+    /// Follows the focused children down to a leaf, taking the first sub node wherever
+    /// nothing has been focused yet.
+    [[nodiscard]] std::shared_ptr<LeafContainer> get_focused_leaf() const;
+
+    /// Calls [f] with a reference to each container beneath this one, depth first.
+    /// The walk is inlined and touches no reference counts. Returns true if [f]
+    /// stopped it early.
+    template <typename F>
+    bool for_each_node(F&& f, TraversalOrder order = TraversalOrder::pre) const;
+
+    /// Calls [f] with each [LeafContainer] beneath this one, in layout order.
+    template <typename F>
+    bool for_each_leaf(F&& f) const;
+
+    /// Returns the shown leaf whose visible area contains [point], or nothing if the point
+    /// is in a gap. The sub nodes of a horizontal or vertical container are ordered along
+    /// its main axis, so each level of the tree is binary searched, while a tabbed or
+    /// stacked container only leads to its shown sub node. Nothing is allocated.
+    [[nodiscard]] std::shared_ptr<LeafContainer> find_leaf_at(geom::Point const& point) const;
     LayoutScheme get_direction() { return scheme; }
     std::vector<std::shared_ptr<Container>> const& get_sub_nodes() const;
     [[nodiscard]] int get_index_of_node(Container const* node) const;
@@ -110,6 +174,7 @@ public:
     bool set_layout(LayoutScheme scheme) override;
     LayoutScheme get_layout() const override;
     nlohmann::json to_json() const override;
+    void snapshot(ContainerSnapshotBuffer& buffer) const override;
     [[nodiscard]] LayoutScheme get_scheme() const { return scheme; }
 
 private:
@@ -123,11 +188,67 @@ private:
     LayoutScheme scheme = LayoutScheme::horizontal;
     std::vector<std::shared_ptr<Container>> sub_nodes;
     std::shared_ptr<LeafContainer> pending_node;
+    std::weak_ptr<Container> focused_child;
+
+    /// The share of the main axis that each of the [sub_nodes] takes. The weights sum to 1,
+    /// so the layout never has to be derived from the previous rectangles.
+    std::vector<double> weights;
+
+    /// The placement area that the [sub_nodes] were last laid out in.
+    std::optional<geom::Rectangle> laid_out_area;
+
+    /// Set when [sub_nodes] or [weights] change, so that the next layout cannot be skipped.
+    bool is_layout_dirty = false;
 
     geom::Rectangle create_space(int pending_index);
+    [[nodiscard]] std::vector<geom::Rectangle> calculate_areas(geom::Rectangle const& placement_area) const;
     void relayout();
+
+    /// Stores the index of each of the [sub_nodes] from [first] onward in the node itself.
+    void reindex(size_t first = 0);
 };
 
+template <typename F>
+bool ParentContainer::for_each_node(F&& f, TraversalOrder order) const
+{
+    for (auto const& node : sub_nodes)
+    {
+        if (order == TraversalOrder::pre && detail::visit(f, *node))
+            return true;
+
+        if (auto const* lane = dynamic_cast<ParentContainer const*>(node.get()))
+        {
+            if (lane->for_each_node(f, order))
+                return true;
+        }
+
+        if (order == TraversalOrder::post && detail::visit(f, *node))
+            return true;
+    }
+
+    return false;
+}
+
+template <typename F>
+bool ParentContainer::for_each_leaf(F&& f) const
+{
+    for (auto const& node : sub_nodes)
+    {
+        if (auto* leaf = dynamic_cast<LeafContainer*>(node.get()))
+        {
+            if (detail::visit(f, *leaf))
+                return true;
+        }
+        else if (auto const* lane = dynamic_cast<ParentContainer const*>(node.get()))
+        {
+            if (lane->for_each_leaf(f))
+                return true;
+        }
+    }
+
+    return false;
+}
+
 } // miracle
 
 #endif // MIRACLEWM_PARENT_NODE_H
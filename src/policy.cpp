@@ -21,10 +21,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "config.h"
 #include "container_group_container.h"
 #include "feature_flags.h"
+#include "geometric_selection.h"
+#include "leaf_container.h"
 #include "shell_component_container.h"
+#include "window_helpers.h"
 #include "window_tools_accessor.h"
 #include "workspace_manager.h"
 
+#include <algorithm>
 #include <iostream>
 #include <mir/geometry/rectangle.h>
 #include <mir/log.h>
@@ -64,13 +68,14 @@ Policy::Policy(
 { return get_active_output(); }) },
     animator(server.the_main_loop(), config),
     window_controller(tools, animator, state),
-    i3_command_executor(*this, workspace_manager, tools, external_client_launcher, window_controller),
+    i3_command_executor(*this, workspace_manager, tools, external_client_launcher, window_controller, window_index),
     surface_tracker { surface_tracker },
     ipc { std::make_shared<Ipc>(runner, workspace_manager, *this, server.the_main_loop(), i3_command_executor, config) }
 {
     animator.start();
     workspace_observer_registrar.register_interest(ipc);
     mode_observer_registrar.register_interest(ipc);
+    window_observer_registrar.register_interest(ipc);
     WindowToolsAccessor::get_instance().set_tools(tools);
 }
 
@@ -78,6 +83,7 @@ Policy::~Policy()
 {
     workspace_observer_registrar.unregister_interest(ipc.get());
     mode_observer_registrar.unregister_interest(ipc.get());
+    window_observer_registrar.unregister_interest(ipc.get());
 }
 
 bool Policy::handle_keyboard_event(MirKeyboardEvent const* event)
@@ -88,7 +94,7 @@ bool Policy::handle_keyboard_event(MirKeyboardEvent const* event)
     state.modifiers = modifiers;
 
     auto custom_key_command = config->matches_custom_key_command(action, scan_code, modifiers);
-    if (custom_key_command != nullptr)
+    if (custom_key_command)
     {
         external_client_launcher.launch({ custom_key_command->command });
         return true;
@@ -213,14 +219,7 @@ bool Policy::handle_pointer_event(MirPointerEvent const* event)
     {
         if (output->point_is_in_output(static_cast<int>(x), static_cast<int>(y)))
         {
-            if (state.active_output != output)
-            {
-                if (state.active_output)
-                    state.active_output->set_is_active(false);
-                state.active_output = output;
-                state.active_output->set_is_active(true);
-                workspace_manager.request_focus(output->get_active_workspace_num());
-            }
+            set_active_output(output);
             break;
         }
     }
@@ -235,7 +234,7 @@ bool Policy::handle_pointer_event(MirPointerEvent const* event)
                 if (state.mode != WindowManagerMode::selecting)
                 {
                     state.mode = WindowManagerMode::selecting;
-                    group_selection = std::make_shared<ContainerGroupContainer>(state);
+                    group_selection = make_container<ContainerGroupContainer>(state);
                     state.active = group_selection;
                     mode_observer_registrar.advise_changed(state.mode);
                 }
@@ -251,7 +250,7 @@ bool Policy::handle_pointer_event(MirPointerEvent const* event)
         }
 
         // Get Container intersection. Depending on the state, do something with that Container
-        std::shared_ptr<Container> intersected = state.active_output->intersect(event);
+        std::shared_ptr<Container> intersected = state.active_output->intersect(event, window_index);
         switch (state.mode)
         {
         case WindowManagerMode::normal:
@@ -319,6 +318,7 @@ void Policy::advise_new_window(miral::WindowInfo const& window_info)
         {
             // Our output is gone! Let's try to add it to a different output
             output_list.front()->add_immediately(window);
+            update_window_index(window);
         }
         else
         {
@@ -327,6 +327,7 @@ void Policy::advise_new_window(miral::WindowInfo const& window_info)
             // we have more data on them.
             orphaned_window_list.push_back(window);
             surface_tracker.add(window);
+            update_window_index(window);
         }
 
         return;
@@ -341,6 +342,8 @@ void Policy::advise_new_window(miral::WindowInfo const& window_info)
     pending_output.reset();
 
     surface_tracker.add(window_info.window());
+    update_window_index(window_info.window());
+    window_observer_registrar.advise_window_changed(WindowChange::created, container);
 }
 
 void Policy::handle_window_ready(miral::WindowInfo& window_info)
@@ -389,7 +392,9 @@ void Policy::advise_focus_gained(const miral::WindowInfo& window_info)
     default:
     {
         state.active = container;
+        window_index.mark_focused(window_info.window());
         container->on_focus_gained();
+        window_observer_registrar.advise_window_changed(WindowChange::focused, container);
         break;
     }
     }
@@ -417,6 +422,7 @@ void Policy::advise_delete_window(const miral::WindowInfo& window_info)
         {
             orphaned_window_list.erase(it);
             surface_tracker.remove(window_info.window());
+            window_index.remove(window_info.window());
             return;
         }
     }
@@ -428,10 +434,12 @@ void Policy::advise_delete_window(const miral::WindowInfo& window_info)
         return;
     }
 
+    window_observer_registrar.advise_window_changed(WindowChange::closed, container);
     if (container->get_output())
         container->get_output()->delete_container(container);
 
     surface_tracker.remove(window_info.window());
+    window_index.remove(window_info.window());
 
     if (state.active == container)
         state.active = nullptr;
@@ -466,6 +474,7 @@ void Policy::advise_output_create(miral::Output const& output)
         for (auto& window : orphaned_window_list)
         {
             state.active_output->add_immediately(window);
+            update_window_index(window);
         }
         orphaned_window_list.clear();
     }
@@ -509,7 +518,8 @@ void Policy::advise_output_delete(miral::Output const& output)
                 for (auto& window : other_output->collect_all_windows())
                 {
                     orphaned_window_list.push_back(window);
-                    window_controller.set_user_data(window, std::make_shared<ShellComponentContainer>(window, window_controller));
+                    window_controller.set_user_data(window, make_container<ShellComponentContainer>(window, window_controller));
+                    update_window_index(window);
                 }
 
                 remove_workspaces();
@@ -523,6 +533,7 @@ void Policy::advise_output_delete(miral::Output const& output)
                 for (auto& window : other_output->collect_all_windows())
                 {
                     state.active_output->add_immediately(window);
+                    update_window_index(window);
                 }
 
                 remove_workspaces();
@@ -543,7 +554,17 @@ void Policy::handle_modify_window(
         return;
     }
 
+    bool const was_fullscreen = window_helpers::is_window_fullscreen(window_info.state());
     container->handle_modify(modifications);
+
+    if (modifications.name().is_set())
+    {
+        update_window_index(window_info.window());
+        window_observer_registrar.advise_window_changed(WindowChange::title, container);
+    }
+    if (modifications.state().is_set()
+        && window_helpers::is_window_fullscreen(modifications.state().value()) != was_fullscreen)
+        window_observer_registrar.advise_window_changed(WindowChange::fullscreen_mode, container);
 }
 
 void Policy::handle_raise_window(miral::WindowInfo& window_info)
@@ -710,7 +731,11 @@ bool Policy::try_move(miracle::Direction direction)
     if (!state.active)
         return false;
 
-    return state.active->move(direction);
+    if (!state.active->move(direction))
+        return false;
+
+    window_observer_registrar.advise_window_changed(WindowChange::moved, state.active);
+    return true;
 }
 
 bool Policy::try_move_by(miracle::Direction direction, int pixels)
@@ -721,7 +746,11 @@ bool Policy::try_move_by(miracle::Direction direction, int pixels)
     if (!state.active)
         return false;
 
-    return state.active->move_by(direction, pixels);
+    if (!state.active->move_by(direction, pixels))
+        return false;
+
+    window_observer_registrar.advise_window_changed(WindowChange::moved, state.active);
+    return true;
 }
 
 bool Policy::try_move_to(int x, int y)
@@ -732,7 +761,11 @@ bool Policy::try_move_to(int x, int y)
     if (!state.active)
         return false;
 
-    return state.active->move_to(x, y);
+    if (!state.active->move_to(x, y))
+        return false;
+
+    window_observer_registrar.advise_window_changed(WindowChange::moved, state.active);
+    return true;
 }
 
 bool Policy::try_select(miracle::Direction direction)
@@ -743,9 +776,70 @@ bool Policy::try_select(miracle::Direction direction)
     if (!state.active)
         return false;
 
+    if (config->snapshot()->focus_mode == FocusMode::geometric)
+        return try_select_geometric(direction);
+
     return state.active->select_next(direction);
 }
 
+bool Policy::try_select_geometric(miracle::Direction direction)
+{
+    if (state.active->is_fullscreen())
+        return false;
+
+    auto const from = state.active->get_visible_area();
+    if (auto output = state.active->get_output())
+    {
+        auto const& workspace = output->get_active_workspace();
+        if (workspace)
+        {
+            if (auto leaf = find_nearest_leaf(*workspace->get_tree(), from, direction, state.active.get()))
+            {
+                window_controller.select_active_window(leaf->window().value());
+                return true;
+            }
+        }
+    }
+
+    // Nothing on this output lies in that direction, so try the outputs beyond it, nearest first
+    std::vector<std::pair<DirectionalDistance, std::shared_ptr<Output>>> outputs;
+    for (auto const& output : output_list)
+    {
+        if (auto distance = measure_in_direction(from, output->get_area(), direction))
+            outputs.emplace_back(distance.value(), output);
+    }
+    std::sort(outputs.begin(), outputs.end(), [](auto const& a, auto const& b)
+    { return a.first < b.first; });
+
+    for (auto const& [distance, output] : outputs)
+    {
+        auto const& workspace = output->get_active_workspace();
+        if (!workspace)
+            continue;
+
+        if (auto leaf = find_nearest_leaf(*workspace->get_tree(), from, direction))
+        {
+            set_active_output(output);
+            window_controller.select_active_window(leaf->window().value());
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Policy::set_active_output(std::shared_ptr<Output> const& output)
+{
+    if (state.active_output == output)
+        return;
+
+    if (state.active_output)
+        state.active_output->set_is_active(false);
+    state.active_output = output;
+    state.active_output->set_is_active(true);
+    workspace_manager.request_focus(output->get_active_workspace_num());
+}
+
 bool Policy::try_close_window()
 {
     if (!state.active)
@@ -774,7 +868,11 @@ bool Policy::try_toggle_fullscreen()
     if (!state.active)
         return false;
 
-    return state.active->toggle_fullscreen();
+    if (!state.active->toggle_fullscreen())
+        return false;
+
+    window_observer_registrar.advise_window_changed(WindowChange::fullscreen_mode, state.active);
+    return true;
 }
 
 bool Policy::select_workspace(int number, bool back_and_forth)
@@ -853,6 +951,7 @@ bool Policy::move_active_to_workspace(int number, bool back_and_forth)
     auto output = workspace_manager.request_workspace(
         state.active_output, number, back_and_forth);
     output->graft(container);
+    window_observer_registrar.advise_window_changed(WindowChange::moved, container);
     return true;
 }
 
@@ -868,6 +967,7 @@ bool Policy::move_active_to_workspace_named(std::string const& name, bool back_a
     if (workspace_manager.request_workspace(name, back_and_forth))
     {
         state.active_output->graft(container);
+        window_observer_registrar.advise_window_changed(WindowChange::moved, container);
         return true;
     }
 
@@ -886,6 +986,7 @@ bool Policy::move_active_to_next()
     if (workspace_manager.request_next(state.active_output))
     {
         state.active_output->graft(container);
+        window_observer_registrar.advise_window_changed(WindowChange::moved, container);
         return true;
     }
 
@@ -904,6 +1005,7 @@ bool Policy::move_active_to_prev()
     if (workspace_manager.request_prev(state.active_output))
     {
         state.active_output->graft(container);
+        window_observer_registrar.advise_window_changed(WindowChange::moved, container);
         return true;
     }
 
@@ -922,6 +1024,7 @@ bool Policy::move_active_to_back_and_forth()
     if (workspace_manager.request_back_and_forth())
     {
         state.active_output->graft(container);
+        window_observer_registrar.advise_window_changed(WindowChange::moved, container);
         return true;
     }
 
@@ -950,7 +1053,22 @@ bool Policy::toggle_floating()
     if (!state.active_output)
         return false;
 
+    // Toggling replaces the containers of the affected windows, so they must be reindexed
+    std::vector<miral::Window> affected;
+    if (auto group = Container::as_group(state.active))
+    {
+        for (auto const& weak_container : group->get_containers())
+        {
+            if (auto container = weak_container.lock(); container && container->window())
+                affected.push_back(container->window().value());
+        }
+    }
+    else if (state.active && state.active->window())
+        affected.push_back(state.active->window().value());
+
     state.active_output->request_toggle_active_float();
+    for (auto const& window : affected)
+        update_window_index(window);
     return true;
 }
 
@@ -1017,4 +1135,16 @@ bool Policy::can_set_layout() const
         return false;
 
     return true;
+}
+
+void Policy::update_window_index(miral::Window const& window)
+{
+    auto const& info = window_controller.info_for(window);
+    auto container = window_controller.get_container(window);
+    window_index.update(window, {
+        .app_id = info.application_id(),
+        .title = info.name(),
+        .container_id = reinterpret_cast<std::uintptr_t>(container.get()),
+        .container_type = container ? container->get_type() : ContainerType::none
+    });
 }
\ No newline at end of file
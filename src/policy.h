@@ -27,7 +27,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "mode_observer.h"
 #include "output.h"
 #include "surface_tracker.h"
+#include "window_index.h"
 #include "window_manager_tools_window_controller.h"
+#include "window_observer.h"
 
 #include "workspace_manager.h"
 
@@ -143,6 +145,12 @@ public:
 private:
     bool can_move_container() const;
     bool can_set_layout() const;
+    void update_window_index(miral::Window const&);
+    void set_active_output(std::shared_ptr<Output> const&);
+
+    /// Selects the nearest window on screen in [direction] from the active container,
+    /// continuing onto the nearest output in that direction.
+    bool try_select_geometric(Direction direction);
 
     bool is_starting_ = true;
     CompositorState& state;
@@ -157,10 +165,12 @@ private:
     std::shared_ptr<MiracleConfig> config;
     WorkspaceObserverRegistrar workspace_observer_registrar;
     ModeObserverRegistrar mode_observer_registrar;
+    WindowObserverRegistrar window_observer_registrar;
     WorkspaceManager workspace_manager;
     std::shared_ptr<Ipc> ipc;
     Animator animator;
     WindowManagerToolsWindowController window_controller;
+    WindowIndex window_index;
     I3CommandExecutor i3_command_executor;
     SurfaceTracker& surface_tracker;
     std::shared_ptr<ContainerGroupContainer> group_selection;
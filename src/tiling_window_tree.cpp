@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "tiling_window_tree.h"
 #include "compositor_state.h"
 #include "config.h"
+#include "layout_transaction.h"
 #include "leaf_container.h"
 #include "output.h"
 #include "parent_container.h"
@@ -38,7 +39,7 @@ TilingWindowTree::TilingWindowTree(
     CompositorState const& state,
     std::shared_ptr<MiracleConfig> const& config,
     geom::Rectangle const& area) :
-    root_lane { std::make_shared<ParentContainer>(
+    root_lane { make_container<ParentContainer>(
         window_controller,
         area,
         config,
@@ -53,8 +54,13 @@ TilingWindowTree::TilingWindowTree(
     recalculate_root_node_area();
     config_handle = config->register_listener([&](auto&)
     {
+        // The placement areas do not depend on the inner gaps or borders, so the
+        // layout has to be forced for the windows to pick them up
+        root_lane->invalidate_layout();
         recalculate_root_node_area();
-    });
+    },
+        5,
+        ConfigSection::gaps | ConfigSection::borders);
 }
 
 TilingWindowTree::~TilingWindowTree()
@@ -117,6 +123,8 @@ bool TilingWindowTree::resize_container(miracle::Direction direction, Container&
         return false;
     }
 
+    // The resize starts from the current areas, including changes made earlier in the batch
+    LayoutTransaction::apply_layouts();
     handle_resize(container, direction, config->get_resize_jump());
     return true;
 }
@@ -166,12 +174,7 @@ std::shared_ptr<LeafContainer> TilingWindowTree::select_window_from_point(int x,
     if (is_active_window_fullscreen)
         return active_container();
 
-    auto node = root_lane->find_where([&](std::shared_ptr<Container> const& node)
-    {
-        return node->is_leaf() && node->get_logical_area().contains(geom::Point(x, y));
-    });
-
-    return Container::as_leaf(node);
+    return root_lane->find_leaf_at(geom::Point(x, y));
 }
 
 bool TilingWindowTree::move_container(miracle::Direction direction, Container& container)
@@ -317,6 +320,15 @@ void TilingWindowTree::handle_layout_scheme(LayoutScheme scheme, Container& cont
 
 void TilingWindowTree::advise_focus_gained(LeafContainer& container)
 {
+    // Each parent remembers which of its sub nodes focus was last within, so that
+    // re-entering a parent returns to the same window
+    std::shared_ptr<Container> child = container.shared_from_this();
+    for (auto parent = container.get_parent().lock(); parent; parent = parent->get_parent().lock())
+    {
+        parent->set_focused_child(child);
+        child = parent;
+    }
+
     if (is_active_window_fullscreen)
         window_controller.raise(container.window().value());
     else if (auto const& parent = container.get_parent().lock())
@@ -366,7 +378,7 @@ bool is_vertical_direction(Direction direction)
 }
 
 std::shared_ptr<LeafContainer> get_closest_window_to_select_from_node(
-    std::shared_ptr<Container> node,
+    std::shared_ptr<Container> const& node,
     miracle::Direction direction)
 {
     // This function attempts to get the first window within a node provided the direction that we are coming
@@ -376,25 +388,22 @@ std::shared_ptr<LeafContainer> get_closest_window_to_select_from_node(
     if (node->is_leaf())
         return Container::as_leaf(node);
 
+    auto lane_node = Container::as_parent(node);
+
+    // As in i3, a lane that has been focused before is re-entered where focus left it
+    if (auto const focused = lane_node->get_focused_child())
+        return get_closest_window_to_select_from_node(focused, direction);
+
     bool is_vertical = is_vertical_direction(direction);
     bool is_negative = is_negative_direction(direction);
-    auto lane_node = Container::as_parent(node);
-    if (is_vertical && lane_node->get_direction() == LayoutScheme::vertical
-        || !is_vertical && lane_node->get_direction() == LayoutScheme::horizontal)
-    {
-        if (is_negative)
-        {
-            auto sub_nodes = lane_node->get_sub_nodes();
-            for (auto i = sub_nodes.size() - 1; i != 0; i--)
-            {
-                if (auto retval = get_closest_window_to_select_from_node(sub_nodes[i], direction))
-                    return retval;
-            }
-        }
-    }
+    bool const from_end = is_negative
+        && (is_vertical && lane_node->get_direction() == LayoutScheme::vertical
+            || !is_vertical && lane_node->get_direction() == LayoutScheme::horizontal);
 
-    for (auto const& sub_node : lane_node->get_sub_nodes())
+    auto const& sub_nodes = lane_node->get_sub_nodes();
+    for (size_t i = 0; i < sub_nodes.size(); i++)
     {
+        auto const& sub_node = sub_nodes[from_end ? sub_nodes.size() - 1 - i : i];
         if (auto retval = get_closest_window_to_select_from_node(sub_node, direction))
             return retval;
     }
@@ -427,7 +436,7 @@ std::shared_ptr<LeafContainer> TilingWindowTree::handle_select(
     do
     {
         auto grandparent_direction = parent->get_direction();
-        int index = parent->get_index_of_node(current_node);
+        int index = current_node->get_index_in_parent();
         if (is_vertical && (grandparent_direction == LayoutScheme::vertical || grandparent_direction == LayoutScheme::stacking)
             || !is_vertical && (grandparent_direction == LayoutScheme::horizontal || grandparent_direction == LayoutScheme::tabbing))
         {
@@ -472,7 +481,7 @@ TilingWindowTree::MoveResult TilingWindowTree::handle_move(Container& from, Dire
         if (new_layout_direction == root_lane->get_direction())
             return {};
 
-        auto after_root_lane = std::make_shared<ParentContainer>(
+        auto after_root_lane = make_container<ParentContainer>(
             window_controller,
             root_lane->get_logical_area(),
             config,
@@ -597,11 +606,13 @@ void TilingWindowTree::handle_resize(
         pending_node_resizes.back().size.width = geom::Width { pending_node_resizes.back().size.width.as_int() + leftover_width };
     }
 
-    for (size_t i = 0; i < nodes.size(); i++)
-    {
-        nodes[i]->set_logical_area(pending_node_resizes[i]);
-        nodes[i]->commit_changes();
-    }
+    std::vector<int> sizes;
+    sizes.reserve(pending_node_resizes.size());
+    for (auto const& rectangle : pending_node_resizes)
+        sizes.push_back(is_vertical ? rectangle.size.height.as_int() : rectangle.size.width.as_int());
+
+    parent->set_sizes(sizes);
+    parent->commit_changes();
 }
 
 std::shared_ptr<ParentContainer> TilingWindowTree::handle_remove(std::shared_ptr<Container> const& node)
@@ -719,36 +730,6 @@ bool TilingWindowTree::constrain(Container& container)
     return true;
 }
 
-namespace
-{
-std::shared_ptr<Container> foreach_node_internal(
-    std::function<bool(std::shared_ptr<Container>)> const& f,
-    std::shared_ptr<Container> const& parent)
-{
-    if (f(parent))
-        return parent;
-
-    if (parent->is_leaf())
-        return nullptr;
-
-    for (auto& node : Container::as_parent(parent)->get_sub_nodes())
-    {
-        if (auto result = foreach_node_internal(f, node))
-            return result;
-    }
-
-    return nullptr;
-}
-}
-
-void TilingWindowTree::foreach_node(std::function<void(std::shared_ptr<Container>)> const& f)
-{
-    foreach_node_internal(
-        [&](auto const& node)
-    { f(node); return false; },
-        root_lane);
-}
-
 void TilingWindowTree::hide()
 {
     if (is_hidden)
@@ -773,14 +754,17 @@ std::shared_ptr<LeafContainer> TilingWindowTree::show()
     is_hidden = false;
 
     // TODO: This check is probably unnecessary
-    std::shared_ptr<Container> fullscreen_node = nullptr;
-    foreach_node([&](auto const& container)
+    std::shared_ptr<LeafContainer> fullscreen_node = nullptr;
+    for_each_leaf([&](LeafContainer& leaf)
     {
-        if (container->is_fullscreen())
-            fullscreen_node = container;
+        if (!leaf.is_fullscreen())
+            return false;
+
+        fullscreen_node = std::static_pointer_cast<LeafContainer>(leaf.shared_from_this());
+        return true;
     });
 
-    return Container::as_leaf(fullscreen_node);
+    return fullscreen_node;
 }
 
 bool TilingWindowTree::is_empty()
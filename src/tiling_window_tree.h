@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "container.h"
 #include "direction.h"
 #include "layout_scheme.h"
+#include "parent_container.h"
 #include <memory>
 #include <mir/geometry/rectangle.h>
 #include <miral/window.h>
@@ -124,7 +125,23 @@ public:
         MirWindowState new_state,
         mir::geometry::Rectangle& new_placement);
 
-    void foreach_node(std::function<void(std::shared_ptr<Container>)> const&);
+    /// Calls [f] with the root and every container beneath it. See [ParentContainer::for_each_node].
+    template <typename F>
+    bool for_each_node(F&& f, TraversalOrder order = TraversalOrder::pre) const
+    {
+        if (order == TraversalOrder::pre && detail::visit(f, static_cast<Container&>(*root_lane)))
+            return true;
+        if (root_lane->for_each_node(f, order))
+            return true;
+        return order == TraversalOrder::post && detail::visit(f, static_cast<Container&>(*root_lane));
+    }
+
+    /// Calls [f] with each [LeafContainer] in the tree, in layout order.
+    template <typename F>
+    bool for_each_leaf(F&& f) const
+    {
+        return root_lane->for_each_leaf(std::forward<F>(f));
+    }
 
     /// Shows the containers in this tree and returns a fullscreen container, if any
     std::shared_ptr<LeafContainer> show();
@@ -19,25 +19,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MIRACLE_WM_UTILITY_GENERAL_H
 
 #include <algorithm>
-#include <string>
+#include <charconv>
+#include <string_view>
 
 namespace miracle
 {
-bool try_get_number(std::string const& s, int& out)
+/// Parses the integer at the start of [s]. Like std::stoi, trailing characters are ignored.
+inline bool try_get_number(std::string_view const& s, int& out)
 {
-    try
-    {
-        out = std::stoi(s);
-        return true;
-    }
-    catch (std::invalid_argument const& ex)
-    {
-        return false;
-    }
-    catch (std::out_of_range const& ex)
-    {
-        return false;
-    }
+    auto const* begin = s.data();
+    auto const* end = s.data() + s.size();
+    if (begin != end && *begin == '+')
+        begin++;
+
+    auto [_, error] = std::from_chars(begin, end, out);
+    return error == std::errc();
 }
 }
 
@@ -18,8 +18,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIRACLEWM_TILING_INTERFACE_H
 #define MIRACLEWM_TILING_INTERFACE_H
 
+#include <memory>
 #include <miral/window.h>
 #include <miral/window_info.h>
+#include <optional>
+#include <span>
 
 namespace geom = mir::geometry;
 
@@ -29,6 +32,21 @@ class Container;
 class TilingWindowTree;
 class AnimationStepResult;
 
+/// What committing a container changes about its window. A commit gathers one
+/// of these per changed window and hands them to [WindowController::apply] together.
+struct PendingWindowChange
+{
+    miral::Window window;
+    std::shared_ptr<Container> container;
+    std::optional<MirWindowState> state;
+
+    /// The visible areas to move the window from and to, if it has moved.
+    std::optional<std::pair<geom::Rectangle, geom::Rectangle>> rectangle;
+
+    /// The area to clip the window to, or nothing to remove the clip.
+    std::optional<geom::Rectangle> clip;
+};
+
 /**
  * The sole interface for making changes to a window. This interface allows
  * all interactions with a window to be testable.
@@ -52,6 +70,23 @@ public:
     virtual void set_user_data(miral::Window const&, std::shared_ptr<void> const&) = 0;
     virtual void modify(miral::Window const&, miral::WindowSpecification const&) = 0;
     virtual miral::WindowInfo& info_for(miral::Window const&) = 0;
+
+    /// Applies [changes] in order. Implementations may override this to look each
+    /// window up once, rather than once for each of its changes.
+    virtual void apply(std::span<PendingWindowChange const> changes)
+    {
+        for (auto const& change : changes)
+        {
+            if (change.state)
+                change_state(change.window, change.state.value());
+            if (change.rectangle)
+                set_rectangle(change.window, change.rectangle->first, change.rectangle->second);
+            if (change.clip)
+                clip(change.window, change.clip.value());
+            else
+                noclip(change.window);
+        }
+    }
 };
 
 }
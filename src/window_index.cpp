@@ -0,0 +1,268 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "window_index.h"
+#include "i3_command.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+using namespace miracle;
+
+namespace
+{
+mir::scene::Surface const* get_surface(miral::Window const& window)
+{
+    return window.operator std::shared_ptr<mir::scene::Surface>().get();
+}
+
+template <typename Map>
+void erase_pair(Map& map, typename Map::key_type const& key, mir::scene::Surface const* surface)
+{
+    auto [begin, end] = map.equal_range(key);
+    for (auto it = begin; it != end; it++)
+    {
+        if (it->second == surface)
+        {
+            map.erase(it);
+            return;
+        }
+    }
+}
+
+/// Returns the literal text that every subject matching [pattern] must begin with.
+/// Only patterns that are anchored with '^' have such a prefix. [is_exact] is set
+/// when the pattern is a literal that is anchored at both ends.
+std::optional<std::string> get_anchored_literal(std::string const& pattern, bool& is_exact)
+{
+    is_exact = false;
+    if (pattern.empty() || pattern[0] != '^' || pattern.find('|') != std::string::npos)
+        return std::nullopt;
+
+    std::string literal;
+    for (size_t i = 1; i < pattern.size(); i++)
+    {
+        char const c = pattern[i];
+        if (c == '*' || c == '?' || c == '{')
+        {
+            // The previous character is optional, so it cannot be part of the prefix
+            if (!literal.empty())
+                literal.pop_back();
+            return literal;
+        }
+
+        if (c == '$' && i == pattern.size() - 1)
+        {
+            is_exact = true;
+            return literal;
+        }
+
+        if (strchr("\\.[]()+^$", c))
+            return literal;
+
+        literal.push_back(c);
+    }
+
+    return literal;
+}
+
+/// Collects the windows whose key in [map] may satisfy the regex [pattern].
+/// Returns nothing when the pattern does not narrow down the search.
+std::optional<std::vector<mir::scene::Surface const*>> find_by_pattern(
+    std::multimap<std::string, mir::scene::Surface const*> const& map,
+    std::string const& pattern)
+{
+    bool is_exact;
+    auto literal = get_anchored_literal(pattern, is_exact);
+    if (!literal || (literal->empty() && !is_exact))
+        return std::nullopt;
+
+    std::vector<mir::scene::Surface const*> result;
+    if (is_exact)
+    {
+        auto [begin, end] = map.equal_range(literal.value());
+        for (auto it = begin; it != end; it++)
+            result.push_back(it->second);
+        return result;
+    }
+
+    for (auto it = map.lower_bound(literal.value()); it != map.end(); it++)
+    {
+        if (it->first.compare(0, literal->size(), literal.value()) != 0)
+            break;
+        result.push_back(it->second);
+    }
+
+    return result;
+}
+}
+
+void WindowIndex::update(miral::Window const& window, WindowIndexEntry const& entry)
+{
+    auto surface = get_surface(window);
+    auto it = entries.find(surface);
+    if (it != entries.end())
+    {
+        unlink(surface, it->second.entry);
+        it->second.window = window;
+        it->second.entry = entry;
+    }
+    else
+        entries.insert({ surface, { window, entry } });
+
+    by_app_id.insert({ entry.app_id, surface });
+    by_title.insert({ entry.title, surface });
+    if (entry.container_id)
+        by_container_id[entry.container_id] = surface;
+    by_container_type[entry.container_type].insert(surface);
+}
+
+void WindowIndex::remove(miral::Window const& window)
+{
+    auto surface = get_surface(window);
+    auto it = entries.find(surface);
+    if (it == entries.end())
+        return;
+
+    unlink(surface, it->second.entry);
+    entries.erase(it);
+}
+
+void WindowIndex::mark_focused(miral::Window const& window)
+{
+    auto it = entries.find(get_surface(window));
+    if (it != entries.end())
+        it->second.last_focused = ++focus_sequence;
+}
+
+void WindowIndex::sort_by_focus(std::vector<miral::Window>& windows) const
+{
+    auto const last_focused = [&](miral::Window const& window) -> uint64_t
+    {
+        auto it = entries.find(get_surface(window));
+        return it == entries.end() ? 0 : it->second.last_focused;
+    };
+
+    std::stable_sort(windows.begin(), windows.end(), [&](miral::Window const& a, miral::Window const& b)
+    {
+        return last_focused(a) > last_focused(b);
+    });
+}
+
+WindowIndexEntry const* WindowIndex::find(miral::Window const& window) const
+{
+    auto it = entries.find(get_surface(window));
+    if (it == entries.end())
+        return nullptr;
+
+    return &it->second.entry;
+}
+
+void WindowIndex::unlink(mir::scene::Surface const* surface, WindowIndexEntry const& entry)
+{
+    erase_pair(by_app_id, entry.app_id, surface);
+    erase_pair(by_title, entry.title, surface);
+
+    auto container_it = by_container_id.find(entry.container_id);
+    if (container_it != by_container_id.end() && container_it->second == surface)
+        by_container_id.erase(container_it);
+
+    auto type_it = by_container_type.find(entry.container_type);
+    if (type_it != by_container_type.end())
+        type_it->second.erase(surface);
+}
+
+std::vector<miral::Window> WindowIndex::find_candidates(std::vector<I3Scope> const& scope) const
+{
+    // Each criteria that the index can answer yields a set of candidates. As a window
+    // must meet every criteria, the smallest of those sets is sufficient.
+    std::optional<std::vector<mir::scene::Surface const*>> best;
+    auto const narrow = [&](std::vector<mir::scene::Surface const*>&& candidates)
+    {
+        if (!best || candidates.size() < best->size())
+            best = std::move(candidates);
+    };
+
+    auto const narrow_by_type = [&](ContainerType type)
+    {
+        auto it = by_container_type.find(type);
+        if (it == by_container_type.end())
+            narrow({});
+        else
+            narrow({ it->second.begin(), it->second.end() });
+    };
+
+    for (auto const& criteria : scope)
+    {
+        switch (criteria.type)
+        {
+        case I3ScopeType::con_id:
+        {
+            if (criteria.matches_focused || !criteria.con_id)
+                break;
+
+            auto it = by_container_id.find(criteria.con_id.value());
+            if (it == by_container_id.end())
+                narrow({});
+            else
+                narrow({ it->second });
+            break;
+        }
+        case I3ScopeType::con_mark:
+            // TODO: Containers cannot be marked yet, so nothing matches
+            narrow({});
+            break;
+        case I3ScopeType::app_id:
+        case I3ScopeType::title:
+        {
+            if (!criteria.regex)
+                break;
+
+            auto const& map = criteria.type == I3ScopeType::app_id ? by_app_id : by_title;
+            if (auto candidates = find_by_pattern(map, criteria.regex.value()))
+                narrow(std::move(candidates.value()));
+            break;
+        }
+        case I3ScopeType::floating:
+            narrow_by_type(ContainerType::floating_window);
+            break;
+        case I3ScopeType::tiling:
+            narrow_by_type(ContainerType::leaf);
+            break;
+        default:
+            break;
+        }
+
+        if (best && best->empty())
+            return {};
+    }
+
+    std::vector<miral::Window> result;
+    if (!best)
+    {
+        result.reserve(entries.size());
+        for (auto const& [_, record] : entries)
+            result.push_back(record.window);
+        return result;
+    }
+
+    result.reserve(best->size());
+    for (auto surface : best.value())
+        result.push_back(entries.at(surface).window);
+    return result;
+}
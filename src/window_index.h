@@ -0,0 +1,109 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLEWM_WINDOW_INDEX_H
+#define MIRACLEWM_WINDOW_INDEX_H
+
+#include "container.h"
+#include <cstdint>
+#include <map>
+#include <miral/window.h>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace miracle
+{
+
+struct I3Scope;
+
+/// The properties of a window that [WindowIndex] can look up by.
+struct WindowIndexEntry
+{
+    std::string app_id;
+    std::string title;
+    std::uintptr_t container_id = 0;
+    ContainerType container_type = ContainerType::none;
+};
+
+/// Indexes every managed window by the properties that i3 criteria
+/// most often select on. The index only narrows a scope down to a set
+/// of candidates: each candidate must still be checked against the full
+/// criteria, as properties such as the workspace are not tracked here.
+class WindowIndex
+{
+public:
+    /// Adds the window to the index, or replaces its entry if it is already indexed.
+    void update(miral::Window const&, WindowIndexEntry const&);
+    void remove(miral::Window const&);
+    [[nodiscard]] WindowIndexEntry const* find(miral::Window const&) const;
+    [[nodiscard]] size_t size() const { return entries.size(); }
+
+    /// Returns true if [predicate] holds for any window whose container is of [type].
+    template <typename F>
+    [[nodiscard]] bool any_of_type(ContainerType type, F&& predicate) const
+    {
+        auto const it = by_container_type.find(type);
+        if (it == by_container_type.end())
+            return false;
+
+        for (auto const* surface : it->second)
+        {
+            if (predicate(entries.at(surface).window))
+                return true;
+        }
+        return false;
+    }
+
+    /// Returns the windows that may satisfy the scope. When none of the
+    /// criteria can be answered by the index, every window is returned.
+    [[nodiscard]] std::vector<miral::Window> find_candidates(std::vector<I3Scope> const& scope) const;
+
+    /// Records that the window has gained focus. Focus order is kept across [update].
+    void mark_focused(miral::Window const&);
+
+    /// Orders [windows] from the most to the least recently focused. Windows that have
+    /// never been focused come last, in a stable order.
+    void sort_by_focus(std::vector<miral::Window>& windows) const;
+
+private:
+    struct Record
+    {
+        miral::Window window;
+        WindowIndexEntry entry;
+
+        /// The value of [focus_sequence] when the window was last focused, or 0 if never.
+        uint64_t last_focused = 0;
+    };
+
+    /// Records keyed by the surface of the window, like [SurfaceTracker].
+    std::map<mir::scene::Surface const*, Record> entries;
+
+    /// Ordered so that a pattern such as "^firefox" resolves to a range of keys.
+    std::multimap<std::string, mir::scene::Surface const*> by_app_id;
+    std::multimap<std::string, mir::scene::Surface const*> by_title;
+    std::unordered_map<std::uintptr_t, mir::scene::Surface const*> by_container_id;
+    std::map<ContainerType, std::set<mir::scene::Surface const*>> by_container_type;
+    uint64_t focus_sequence = 0;
+
+    void unlink(mir::scene::Surface const*, WindowIndexEntry const&);
+};
+
+} // miracle
+
+#endif // MIRACLEWM_WINDOW_INDEX_H
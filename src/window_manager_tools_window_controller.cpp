@@ -72,6 +72,15 @@ void WindowManagerToolsWindowController::set_rectangle(
         return;
     }
 
+    animate_move(container, window, from, to);
+}
+
+void WindowManagerToolsWindowController::animate_move(
+    std::shared_ptr<Container> const& container,
+    miral::Window const& window,
+    geom::Rectangle const& from,
+    geom::Rectangle const& to)
+{
     animator.window_move(
         container->animation_handle(),
         from,
@@ -83,6 +92,31 @@ void WindowManagerToolsWindowController::set_rectangle(
     });
 }
 
+void WindowManagerToolsWindowController::apply(std::span<PendingWindowChange const> changes)
+{
+    // Each window is looked up once, and the container is already known, so a commit
+    // costs one pass over the changed windows
+    for (auto const& change : changes)
+    {
+        auto& info = tools.info_for(change.window);
+        if (change.state)
+        {
+            miral::WindowSpecification spec;
+            spec.state() = change.state.value();
+            tools.place_and_size_for_state(spec, info);
+            tools.modify_window(change.window, spec);
+        }
+
+        if (change.rectangle)
+            animate_move(change.container, change.window, change.rectangle->first, change.rectangle->second);
+
+        if (change.clip)
+            info.clip_area(change.clip.value());
+        else
+            info.clip_area(mir::optional_value<geom::Rectangle>());
+    }
+}
+
 MirWindowState WindowManagerToolsWindowController::get_state(miral::Window const& window)
 {
     auto& window_info = tools.info_for(window);
@@ -49,8 +49,15 @@ public:
     void modify(miral::Window const&, miral::WindowSpecification const&) override;
     miral::WindowInfo& info_for(miral::Window const&) override;
     void close(miral::Window const& window) override;
+    void apply(std::span<PendingWindowChange const> changes) override;
 
 private:
+    void animate_move(
+        std::shared_ptr<Container> const& container,
+        miral::Window const& window,
+        geom::Rectangle const& from,
+        geom::Rectangle const& to);
+
     miral::WindowManagerTools tools;
     Animator& animator;
     CompositorState& state;
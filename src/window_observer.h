@@ -0,0 +1,57 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLEWM_WINDOW_OBSERVER_H
+#define MIRACLEWM_WINDOW_OBSERVER_H
+
+#include "observer_registrar.h"
+#include <memory>
+
+namespace miracle
+{
+
+class Container;
+
+/// Describes how a window has changed. These map onto the "change"
+/// field of i3's window event.
+enum class WindowChange
+{
+    created,
+    closed,
+    focused,
+    title,
+    moved,
+    fullscreen_mode
+};
+
+class WindowObserver
+{
+public:
+    virtual ~WindowObserver() = default;
+    virtual void on_window_changed(WindowChange change, std::shared_ptr<Container> const& container) = 0;
+};
+
+class WindowObserverRegistrar : public ObserverRegistrar<WindowObserver>
+{
+public:
+    WindowObserverRegistrar() = default;
+    void advise_window_changed(WindowChange change, std::shared_ptr<Container> const& container);
+};
+
+}
+
+#endif // MIRACLEWM_WINDOW_OBSERVER_H
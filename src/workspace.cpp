@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "compositor_state.h"
 #include "config.h"
 #include "container_group_container.h"
+#include "container_snapshot.h"
 #include "floating_tree_container.h"
 #include "floating_window_container.h"
 #include "leaf_container.h"
@@ -148,7 +149,7 @@ std::shared_ptr<Container> Workspace::create_container(
         break;
     }
     case ContainerType::shell:
-        container = std::make_shared<ShellComponentContainer>(window_info.window(), window_controller);
+        container = make_container<ShellComponentContainer>(window_info.window(), window_controller);
         break;
     default:
         mir::log_error("Unsupported window type: %d", (int)hint.container_type);
@@ -228,26 +229,6 @@ void Workspace::hide()
         floating->hide();
 }
 
-void Workspace::for_each_window(std::function<void(std::shared_ptr<Container>)> const& f) const
-{
-    for (auto const& window : floating_windows)
-    {
-        auto container = window_controller.get_container(window->window().value());
-        if (container)
-            f(container);
-    }
-
-    tree->foreach_node([&](std::shared_ptr<Container> const& node)
-    {
-        if (auto leaf = Container::as_leaf(node))
-        {
-            auto container = window_controller.get_container(leaf->window().value());
-            if (container)
-                f(container);
-        }
-    });
-}
-
 void Workspace::toggle_floating(std::shared_ptr<Container> const& container)
 {
     auto const handle_ready = [&](
@@ -305,7 +286,7 @@ void Workspace::toggle_floating(std::shared_ptr<Container> const& container)
     case ContainerType::group:
     {
         auto group = Container::as_group(container);
-        auto tree_container = std::make_shared<FloatingTreeContainer>(
+        auto tree_container = make_container<FloatingTreeContainer>(
             this,
             window_controller,
             state,
@@ -381,7 +362,7 @@ bool Workspace::has_floating_window(std::shared_ptr<Container> const& container)
 
 std::shared_ptr<FloatingWindowContainer> Workspace::add_floating_window(miral::Window const& window)
 {
-    auto floating = std::make_shared<FloatingWindowContainer>(
+    auto floating = make_container<FloatingWindowContainer>(
         window, floating_window_manager, window_controller, this, state, config);
     floating_windows.push_back(floating);
     return floating;
@@ -395,14 +376,14 @@ Output* Workspace::get_output()
 void Workspace::trigger_rerender()
 {
     // TODO: Ugh, sad. I am forced to set the surface transform so that the surface is rerendered
-    for_each_window([&](std::shared_ptr<Container> const& container)
+    for_each_window([&](Container& container)
     {
-        auto window = container->window();
+        auto window = container.window();
         if (window)
         {
             auto surface = window->operator std::shared_ptr<mir::scene::Surface>();
             if (surface)
-                surface->set_transformation(container->get_transform());
+                surface->set_transformation(container.get_transform());
         }
     });
 }
@@ -459,14 +440,24 @@ nlohmann::json Workspace::to_json() const
     //   See: https://i3wm.org/docs/ipc.html#_tree_reply
     auto area = tree->get_area();
 
+    // A single buffer is reused for every container on the workspace
+    ContainerSnapshotBuffer snapshots;
     nlohmann::json floating_nodes = nlohmann::json::array();
     for (auto const& container : floating_windows)
-        floating_nodes.push_back(container->to_json());
+    {
+        snapshots.clear();
+        container->snapshot(snapshots);
+        floating_nodes.push_back(miracle::to_json(snapshots.get()));
+    }
 
+    // The root itself is reported as the workspace, so only its subtrees become nodes
     nlohmann::json nodes = nlohmann::json::array();
     auto const root = tree->get_root();
-    for (auto const& container : root->get_sub_nodes())
-        nodes.push_back(container->to_json());
+    snapshots.clear();
+    root->snapshot(snapshots);
+    auto const all = snapshots.get();
+    for (size_t i = 1; i < all.size(); i += all[i].descendant_count + 1)
+        nodes.push_back(miracle::to_json(all, i));
 
     return {
         { "num",                  workspace                                                       },
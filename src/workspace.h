@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "animator.h"
 #include "container.h"
 #include "direction.h"
+#include "floating_window_container.h"
+#include "tiling_window_tree.h"
 
 #include <glm/glm.hpp>
 #include <memory>
@@ -71,9 +73,24 @@ public:
     void show();
     void hide();
     void transfer_pinned_windows_to(std::shared_ptr<Workspace> const& other);
-    void for_each_window(std::function<void(std::shared_ptr<Container>)> const&) const;
+
+    /// Calls [f] with the floating containers and then with the tiled leaves of this
+    /// workspace. Returning true from [f] stops the walk early.
+    template <typename F>
+    bool for_each_window(F&& f) const
+    {
+        for (auto const& floating : floating_windows)
+        {
+            if (detail::visit(f, static_cast<Container&>(*floating)))
+                return true;
+        }
+
+        return tree->for_each_leaf([&](LeafContainer& leaf)
+        { return detail::visit(f, static_cast<Container&>(leaf)); });
+    }
     void toggle_floating(std::shared_ptr<Container> const&);
     bool has_floating_window(std::shared_ptr<Container> const&);
+    [[nodiscard]] bool has_floating_containers() const { return !floating_windows.empty() || !floating_trees.empty(); }
     std::shared_ptr<FloatingWindowContainer> add_floating_window(miral::Window const&);
     Output* get_output();
     void trigger_rerender();
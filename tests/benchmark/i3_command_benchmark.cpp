@@ -0,0 +1,90 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "i3_command.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace miracle;
+
+namespace
+{
+/// Used when no input files are provided.
+std::vector<std::string> const DEFAULT_COMMANDS = {
+    "exec --no-startup-id miracle-wm-sensible-terminal",
+    "focus left, focus right, focus up, focus down",
+    "[app_id=\"^firefox$\"] focus",
+    "move container to workspace number 3",
+    "move left 10 ppt",
+    "split vertical; split horizontal; split toggle",
+    "layout toggle split tabbed stacking",
+    "workspace 2; workspace next; workspace back_and_forth",
+    "[title=\"(?i)mail\" workspace=\"__focused__\"] focus workspace",
+    "exec \"notify-send \\\"Hello, world; again\\\"\"",
+};
+
+size_t const ITERATIONS = 100000;
+
+std::string read_file(char const* path)
+{
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+}
+
+/// Measures how many commands the i3 command parser gets through per second.
+/// Each argument is a file containing a single payload, such as those in
+/// tests/fuzz/corpus/i3_command. The built-in commands are used otherwise.
+int main(int argc, char** argv)
+{
+    std::vector<std::string> payloads;
+    for (int i = 1; i < argc; i++)
+        payloads.push_back(read_file(argv[i]));
+    if (payloads.empty())
+        payloads = DEFAULT_COMMANDS;
+
+    // Warm up the regex cache so that only parsing is measured
+    size_t commands_per_pass = 0;
+    for (auto const& payload : payloads)
+    {
+        for (auto const& list : I3ScopedCommandList::parse(payload))
+            commands_per_pass += list.commands.size();
+    }
+
+    size_t parsed = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ITERATIONS; i++)
+    {
+        for (auto const& payload : payloads)
+        {
+            for (auto const& list : I3ScopedCommandList::parse(payload))
+                parsed += list.commands.size();
+        }
+    }
+    auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("payloads: %zu, commands per pass: %zu, iterations: %zu\n", payloads.size(), commands_per_pass, ITERATIONS);
+    printf("parsed %zu commands in %.3fs (%.0f commands/s)\n", parsed, elapsed, static_cast<double>(parsed) / elapsed);
+    return 0;
+}
@@ -0,0 +1,323 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "compositor_state.h"
+#include "container_snapshot.h"
+#include "leaf_container.h"
+#include "parent_container.h"
+#include "stub_configuration.h"
+#include "stub_session.h"
+#include "stub_surface.h"
+#include "stub_window_controller.h"
+#include "tiling_window_tree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace miracle;
+
+namespace
+{
+std::atomic<size_t> allocation_count = 0;
+}
+
+// Every allocation in the process is counted so that each operation can report
+// how many it made. The container pool draws from here as well.
+void* operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+/// Used when no sizes are provided.
+std::vector<size_t> const DEFAULT_SIZES = { 10, 100, 1000, 10000 };
+
+/// The number of times that each operation is measured for each tree size.
+size_t const SAMPLES = 200;
+
+/// The trees are generated from a fixed seed so that runs are comparable.
+unsigned int const SEED = 42;
+
+geom::Rectangle const AREA { geom::Point(0, 0), geom::Size(3840, 2160) };
+geom::Rectangle const OTHER_AREA { geom::Point(0, 0), geom::Size(2560, 1440) };
+
+struct Sample
+{
+    double microseconds;
+    size_t allocations;
+};
+
+/// Builds a [TilingWindowTree] against the stub interfaces and keeps the windows
+/// that are placed in it alive.
+class Fixture
+{
+public:
+    Fixture() :
+        tree(
+            std::make_unique<test::StubTilingWindowTreeInterface>(AREA),
+            window_controller,
+            state,
+            std::make_shared<test::StubConfiguration>(),
+            AREA)
+    {
+    }
+
+    /// Places a new window beside [sibling], or in the root if there is no sibling.
+    std::shared_ptr<LeafContainer> add(std::shared_ptr<LeafContainer> const& sibling)
+    {
+        auto parent = sibling ? sibling->get_parent().lock() : nullptr;
+        miral::WindowSpecification spec;
+        spec = tree.place_new_window(spec, parent);
+
+        auto session = std::make_shared<test::StubSession>();
+        auto surface = std::make_shared<test::StubSurface>();
+        sessions.push_back(session);
+        surfaces.push_back(surface);
+
+        miral::Window window(session, surface);
+        miral::WindowInfo info(window, spec);
+        auto leaf = tree.confirm_window(info, parent);
+        pairs.push_back({ window, leaf });
+        leaves.push_back(leaf);
+        return leaf;
+    }
+
+    void remove(size_t index)
+    {
+        auto leaf = leaves[index];
+        leaves[index] = leaves.back();
+        leaves.pop_back();
+        std::erase_if(pairs, [&](auto const& pair)
+        { return pair.second == leaf; });
+
+        if (state.active == leaf)
+            state.active = nullptr;
+        tree.advise_delete_window(leaf);
+    }
+
+    /// Grows the tree to [size] leaves. Each leaf is placed beside a random existing
+    /// leaf, which is sometimes first split into a horizontal, vertical, tabbed or
+    /// stacked parent.
+    void populate(size_t size, std::mt19937& random)
+    {
+        LayoutScheme const schemes[] = {
+            LayoutScheme::horizontal,
+            LayoutScheme::vertical,
+            LayoutScheme::tabbing,
+            LayoutScheme::stacking
+        };
+
+        while (leaves.size() < size)
+        {
+            std::shared_ptr<LeafContainer> sibling;
+            if (!leaves.empty())
+            {
+                sibling = pick(random);
+                if (random() % 4 == 0)
+                    tree.request_layout(*sibling, schemes[random() % 4]);
+            }
+
+            add(sibling);
+        }
+    }
+
+    std::shared_ptr<LeafContainer> const& pick(std::mt19937& random)
+    {
+        return leaves[random() % leaves.size()];
+    }
+
+    CompositorState state;
+    std::vector<std::shared_ptr<test::StubSession>> sessions;
+    std::vector<std::shared_ptr<test::StubSurface>> surfaces;
+    std::vector<std::pair<miral::Window, std::shared_ptr<Container>>> pairs;
+    test::StubWindowController window_controller { pairs };
+    TilingWindowTree tree;
+    std::vector<std::shared_ptr<LeafContainer>> leaves;
+};
+
+template <typename F>
+Sample measure(F const& f)
+{
+    auto const allocations = allocation_count.load(std::memory_order_relaxed);
+    auto const start = std::chrono::steady_clock::now();
+    f();
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+    return {
+        .microseconds = std::chrono::duration<double, std::micro>(elapsed).count(),
+        .allocations = allocation_count.load(std::memory_order_relaxed) - allocations
+    };
+}
+
+void report(char const* operation, size_t size, std::vector<Sample>& samples)
+{
+    std::sort(samples.begin(), samples.end(), [](Sample const& a, Sample const& b)
+    { return a.microseconds < b.microseconds; });
+
+    auto const percentile = [&](double p)
+    {
+        auto const index = static_cast<size_t>(p * static_cast<double>(samples.size() - 1));
+        return samples[index].microseconds;
+    };
+
+    size_t allocations = 0;
+    for (auto const& sample : samples)
+        allocations += sample.allocations;
+
+    printf("%-22s %7zu %10.2f %10.2f %10.2f %10.2f %12.1f\n",
+        operation,
+        size,
+        percentile(0.5),
+        percentile(0.9),
+        percentile(0.99),
+        samples.back().microseconds,
+        static_cast<double>(allocations) / static_cast<double>(samples.size()));
+}
+
+void run(size_t size)
+{
+    std::mt19937 random(SEED);
+    Fixture fixture;
+    fixture.populate(size, random);
+
+    auto const random_direction = [&]()
+    { return static_cast<Direction>(random() % static_cast<int>(Direction::MAX)); };
+
+    std::vector<Sample> samples;
+    samples.reserve(SAMPLES);
+
+    // Each new window is removed again, untimed, so that the tree keeps its size
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        auto sibling = fixture.pick(random);
+        samples.push_back(measure([&]()
+        { fixture.add(sibling); }));
+        fixture.remove(fixture.leaves.size() - 1);
+    }
+    report("confirm_window", size, samples);
+
+    samples.clear();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        auto const index = random() % fixture.leaves.size();
+        auto sibling = fixture.leaves[(index + 1) % fixture.leaves.size()];
+        samples.push_back(measure([&]()
+        { fixture.remove(index); }));
+        fixture.add(fixture.leaves.empty() ? nullptr : sibling);
+    }
+    report("advise_delete_window", size, samples);
+
+    samples.clear();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        auto leaf = fixture.pick(random);
+        auto direction = random_direction();
+        samples.push_back(measure([&]()
+        { fixture.tree.move_container(direction, *leaf); }));
+    }
+    report("move_container", size, samples);
+
+    samples.clear();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        auto leaf = fixture.pick(random);
+        auto direction = random_direction();
+        samples.push_back(measure([&]()
+        { fixture.tree.resize_container(direction, *leaf); }));
+    }
+    report("resize_container", size, samples);
+
+    samples.clear();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        auto leaf = fixture.pick(random);
+        auto direction = random_direction();
+        samples.push_back(measure([&]()
+        { fixture.tree.select_next(direction, *leaf); }));
+    }
+    report("select_next", size, samples);
+
+    samples.clear();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        auto const& area = i % 2 == 0 ? OTHER_AREA : AREA;
+        samples.push_back(measure([&]()
+        { fixture.tree.set_area(area); }));
+    }
+    report("set_area", size, samples);
+
+    samples.clear();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        samples.push_back(measure([&]()
+        { auto json = fixture.tree.get_root()->to_json(); }));
+    }
+    report("to_json", size, samples);
+
+    samples.clear();
+    ContainerSnapshotBuffer snapshots;
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        samples.push_back(measure([&]()
+        {
+            snapshots.clear();
+            fixture.tree.get_root()->snapshot(snapshots);
+        }));
+    }
+    report("snapshot", size, samples);
+}
+}
+
+/// Measures the latency of the layout operations of [TilingWindowTree] on random
+/// trees of increasing size. Each argument is a number of leaves, and the default
+/// sizes are used otherwise. Times are in microseconds.
+int main(int argc, char** argv)
+{
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++)
+        sizes.push_back(std::stoul(argv[i]));
+    if (sizes.empty())
+        sizes = DEFAULT_SIZES;
+
+    printf("seed: %u, samples per operation: %zu\n", SEED, SAMPLES);
+    printf("%-22s %7s %10s %10s %10s %10s %12s\n",
+        "operation", "leaves", "p50", "p90", "p99", "max", "allocs/op");
+    for (auto const size : sizes)
+        run(size);
+
+    return 0;
+}
@@ -34,6 +34,7 @@ public:
     void TearDown() override
     {
         std::filesystem::remove(path.c_str());
+        std::filesystem::remove(path + ".cache");
     }
 
     void write_kvp(std::string key, std::string value)
@@ -467,3 +468,123 @@ TEST_F(FilesystemConfigurationTest, BorderCanbeParsedObjectColor)
     EXPECT_EQ(config.get_border_config().color.b, 30.f / 255.f);
     EXPECT_EQ(config.get_border_config().color.a, 55.f / 255.f);
 }
+
+TEST_F(FilesystemConfigurationTest, KeyCommandIsNotMatchedWithoutPrimaryModifier)
+{
+    FilesystemConfiguration config(runner, path, true);
+    bool called = false;
+    auto matched = config.matches_key_command(
+        MirKeyboardAction::mir_keyboard_action_down,
+        KEY_ENTER,
+        mir_input_event_modifier_none,
+        [&](DefaultKeyCommand command)
+    {
+        called = true;
+        return true;
+    });
+    EXPECT_FALSE(matched);
+    EXPECT_FALSE(called);
+}
+
+TEST_F(FilesystemConfigurationTest, KeyCommandsBoundToTheSameKeyAreTriedInOrder)
+{
+    YAML::Node node;
+    YAML::Node action_override_node;
+    action_override_node["name"] = "fullscreen";
+    action_override_node["action"] = "down";
+    action_override_node["modifiers"].push_back("primary");
+    action_override_node["key"] = "KEY_ENTER";
+    node["default_action_overrides"].push_back(action_override_node);
+    write_yaml_node(node);
+
+    FilesystemConfiguration config(runner, path, true);
+    std::vector<DefaultKeyCommand> tried;
+    auto matched = config.matches_key_command(
+        MirKeyboardAction::mir_keyboard_action_down,
+        KEY_ENTER,
+        mir_input_event_modifier_meta,
+        [&](DefaultKeyCommand command)
+    {
+        tried.push_back(command);
+        return command == Fullscreen;
+    });
+    EXPECT_TRUE(matched);
+    ASSERT_EQ(tried.size(), 2);
+    EXPECT_EQ(tried[0], Terminal);
+    EXPECT_EQ(tried[1], Fullscreen);
+}
+
+TEST_F(FilesystemConfigurationTest, CustomActionIsNotMatchedWithDifferentModifiers)
+{
+    YAML::Node node;
+    YAML::Node action_override_node;
+    action_override_node["command"] = "echo Hi";
+    action_override_node["action"] = "down";
+    action_override_node["modifiers"].push_back("primary");
+    action_override_node["key"] = "KEY_X";
+    node["custom_actions"].push_back(action_override_node);
+    write_yaml_node(node);
+
+    FilesystemConfiguration config(runner, path, true);
+    auto custom_action = config.matches_custom_key_command(
+        MirKeyboardAction::mir_keyboard_action_down,
+        KEY_X,
+        mir_input_event_modifier_meta | mir_input_event_modifier_shift);
+    EXPECT_FALSE(custom_action);
+}
+
+TEST_F(FilesystemConfigurationTest, SnapshotIsSharedUntilTheConfigurationChanges)
+{
+    YAML::Node node;
+    YAML::Node vec;
+    vec["x"] = 33;
+    vec["y"] = 44;
+    node["inner_gaps"] = vec;
+    write_yaml_node(node);
+
+    FilesystemConfiguration config(runner, path, true);
+    auto snapshot = config.snapshot();
+    EXPECT_EQ(snapshot->inner_gaps_x, 33);
+    EXPECT_EQ(snapshot->inner_gaps_y, 44);
+    EXPECT_EQ(snapshot, config.snapshot());
+}
+
+TEST_F(FilesystemConfigurationTest, ListenersAreNotNotifiedWithoutAChange)
+{
+    FilesystemConfiguration config(runner, path, true);
+    bool notified = false;
+    config.register_listener([&](ConfigChange const&)
+    {
+        notified = true;
+    });
+
+    config.try_process_change();
+    EXPECT_FALSE(notified);
+}
+
+TEST(ConfigSectionTest, IdenticalDetailsHaveNoChangedSections)
+{
+    ConfigDetails previous;
+    ConfigDetails current;
+    EXPECT_EQ(get_changed_sections(previous, current), ConfigSection::none);
+}
+
+TEST(ConfigSectionTest, ChangingAKeyBindingOnlyMarksKeyBindings)
+{
+    ConfigDetails previous;
+    ConfigDetails current;
+    current.custom_key_commands.push_back({
+        { MirKeyboardAction::mir_keyboard_action_down, mir_input_event_modifier_meta, KEY_X },
+        "echo Hi"
+    });
+    EXPECT_EQ(get_changed_sections(previous, current), ConfigSection::key_bindings);
+}
+
+TEST(ConfigSectionTest, ChangingGapsAndBordersMarksBoth)
+{
+    ConfigDetails previous;
+    ConfigDetails current;
+    current.inner_gaps_x = 20;
+    current.border_config.size = 3;
+    EXPECT_EQ(get_changed_sections(previous, current), ConfigSection::gaps | ConfigSection::borders);
+}
@@ -0,0 +1,61 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "i3_command.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+using namespace miracle;
+
+namespace
+{
+bool is_in_arena(std::string_view const& token, std::string const& arena)
+{
+    return token.data() >= arena.data() && token.data() + token.size() <= arena.data() + arena.size();
+}
+}
+
+/// Feeds arbitrary bytes to the i3 command parser, exactly as if they had arrived
+/// over IPC. Run with: miracle-wm-i3-command-fuzzer corpus/i3_command
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size)
+{
+    std::string_view const view(reinterpret_cast<char const*>(data), size);
+    auto const lists = I3ScopedCommandList::parse(view);
+
+    // Every argument must be a view into the arena that keeps it alive
+    for (auto const& list : lists)
+    {
+        for (auto const& command : list.commands)
+        {
+            for (auto const& argument : command.arguments)
+            {
+                if (!list.arena || !is_in_arena(argument, *list.arena))
+                    __builtin_trap();
+            }
+
+            for (auto const& option : command.options)
+            {
+                if (!list.arena || !is_in_arena(option, *list.arena))
+                    __builtin_trap();
+            }
+        }
+    }
+
+    return 0;
+}
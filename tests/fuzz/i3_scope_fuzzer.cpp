@@ -0,0 +1,42 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "i3_command.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+using namespace miracle;
+
+/// Feeds arbitrary bytes to the criteria parser on its own. The input is not null
+/// terminated, so any read past the end of the view is reported by the sanitizer.
+/// Run with: miracle-wm-i3-scope-fuzzer corpus/i3_scope
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size)
+{
+    std::string_view const view(reinterpret_cast<char const*>(data), size);
+    int ptr = -1;
+    I3Scope::parse(view, ptr);
+
+    // The parser must stop on the closing bracket or at the end of the view
+    if (ptr < 0 || static_cast<size_t>(ptr) > size)
+        __builtin_trap();
+    if (static_cast<size_t>(ptr) < size && ptr > 0 && view[ptr] != ']')
+        __builtin_trap();
+
+    return 0;
+}
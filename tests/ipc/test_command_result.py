@@ -0,0 +1,20 @@
+from i3ipc import Connection
+
+class TestCommandResult:
+    def test_one_result_per_command(self, server):
+        conn = Connection(server.ipc)
+        replies = conn.command("workspace 2, workspace 3")
+        assert len(replies) == 2
+        assert all(reply.success for reply in replies)
+
+    def test_failed_command_reports_failure(self, server):
+        conn = Connection(server.ipc)
+        replies = conn.command("sticky sideways")
+        assert len(replies) == 1
+        assert not replies[0].success
+
+    def test_command_is_applied_before_reply(self, server):
+        conn = Connection(server.ipc)
+        conn.command("workspace 5")
+        workspaces = conn.get_workspaces()
+        assert any(workspace.num == 5 and workspace.focused for workspace in workspaces)
@@ -0,0 +1,74 @@
+from i3ipc import Connection, Event, WindowEvent
+import time
+import threading
+
+class TestWindowEvent:
+    def test_window_new_event(self, server):
+        class Reply:
+            def __init__(self) -> None:
+                self.changes = []
+
+        reply = Reply()
+        def wait_on_window():
+            def on_window(i3, e: WindowEvent):
+                reply.changes.append(e.change)
+                if e.change == "new":
+                    conn1.main_quit()
+
+            conn1 = Connection(server.ipc)
+            conn1.on(Event.WINDOW, on_window)
+            conn1.main()
+
+        t1 = threading.Thread(target=wait_on_window)
+        t1.start()
+        time.sleep(1)  # A small wait time to ensure that the subscribe goes through first
+
+        p = server.open_app("gedit")
+        t1.join()
+        p.terminate()
+
+        assert "new" in reply.changes
+
+    def test_last_focus_event_matches_the_focused_window(self, server):
+        conn = Connection(server.ipc)
+        p1 = server.open_app("gedit")
+        p2 = server.open_app("gedit")
+        time.sleep(2)  # Give both windows time to open
+
+        leaves = conn.get_tree().leaves()
+        assert len(leaves) >= 2
+        first = leaves[0].id
+        second = leaves[1].id
+
+        class Reply:
+            def __init__(self) -> None:
+                self.focused = []
+
+        reply = Reply()
+        def wait_on_focus():
+            def on_window(i3, e: WindowEvent):
+                if e.change == "focus":
+                    reply.focused.append(e.container.id)
+
+            def on_tick(i3, e):
+                if e.payload == "done":
+                    conn1.main_quit()
+
+            conn1 = Connection(server.ipc)
+            conn1.on(Event.WINDOW, on_window)
+            conn1.on(Event.TICK, on_tick)
+            conn1.main()
+
+        t1 = threading.Thread(target=wait_on_focus)
+        t1.start()
+        time.sleep(1)  # A small wait time to ensure that the subscribe goes through first
+
+        # Focus moves from the first window to the second and back within a single message
+        conn.command(f'[con_id="{first}"] focus; [con_id="{second}"] focus; [con_id="{first}"] focus')
+        time.sleep(1)  # The window events are sent on a later iteration of the main loop
+        conn.send_tick("done")
+        t1.join()
+        p1.terminate()
+        p2.terminate()
+
+        assert reply.focused[-1] == first
@@ -29,9 +29,9 @@ namespace test
         void load(mir::Server& server) override { }
         [[nodiscard]] std::string const& get_filename() const override { return ""; }
         [[nodiscard]] MirInputEventModifier get_input_event_modifier() const override { return mir_input_event_modifier_none; }
-        [[nodiscard]] CustomKeyCommand const* matches_custom_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers) const override
+        [[nodiscard]] std::optional<CustomKeyCommand> matches_custom_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers) const override
         {
-            return nullptr;
+            return std::nullopt;
         }
 
         bool matches_key_command(MirKeyboardAction action, int scan_code, unsigned int modifiers, std::function<bool(DefaultKeyCommand)> const& f) const override
@@ -41,12 +41,12 @@ namespace test
 
         [[nodiscard]] int get_inner_gaps_x() const override
         {
-            return 0;
+            return inner_gaps_x;
         }
 
         [[nodiscard]] int get_inner_gaps_y() const override
         {
-            return 0;
+            return inner_gaps_y;
         }
 
         [[nodiscard]] int get_outer_gaps_x() const override
@@ -59,12 +59,12 @@ namespace test
             return 0;
         }
 
-        [[nodiscard]] std::vector<StartupApp> const& get_startup_apps() const override
+        [[nodiscard]] std::vector<StartupApp> get_startup_apps() const override
         {
             return {};
         }
 
-        [[nodiscard]] std::optional<std::string> const& get_terminal_command() const override
+        [[nodiscard]] std::optional<std::string> get_terminal_command() const override
         {
             return std::nullopt;
         }
@@ -74,17 +74,17 @@ namespace test
             return 0;
         }
 
-        [[nodiscard]] std::vector<EnvironmentVariable> const& get_env_variables() const override
+        [[nodiscard]] std::vector<EnvironmentVariable> get_env_variables() const override
         {
             return {};
         }
 
-        [[nodiscard]] BorderConfig const& get_border_config() const override
+        [[nodiscard]] BorderConfig get_border_config() const override
         {
             return border_config;
         }
 
-        [[nodiscard]] std::array<AnimationDefinition, (int)AnimateableEvent::max> const& get_animation_definitions() const override
+        [[nodiscard]] std::array<AnimationDefinition, (int)AnimateableEvent::max> get_animation_definitions() const override
         {
             return animations;
         }
@@ -99,20 +99,28 @@ namespace test
             return WorkspaceConfig(key);
         }
 
-        int register_listener(std::function<void(miracle::MiracleConfig&)> const&) override
+        int register_listener(std::function<void(ConfigChange const&)> const&) override
         {
             return -1;
         }
 
         /// Register a listener on configuration change. A lower "priority" number signifies that the
         /// listener should be triggered earlier. A higher priority means later
-        int register_listener(std::function<void(miracle::MiracleConfig&)> const&, int priority) override
+        int register_listener(std::function<void(ConfigChange const&)> const&, int priority) override
         {
             return -1;
         }
 
+        int register_listener(std::function<void(ConfigChange const&)> const& listener, int priority, ConfigSection sections) override
+        {
+            listeners.push_back({ listener, sections });
+            return static_cast<int>(listeners.size() - 1);
+        }
+
         void unregister_listener(int handle) override
         {
+            if (handle >= 0 && handle < static_cast<int>(listeners.size()))
+                listeners[handle].first = nullptr;
         }
 
         void try_process_change() override { }
@@ -127,7 +135,38 @@ namespace test
             return LayoutScheme::horizontal;
         }
 
+        [[nodiscard]] std::shared_ptr<ConfigDetails const> snapshot() const override
+        {
+            auto details = std::make_shared<ConfigDetails>();
+            details->inner_gaps_x = inner_gaps_x;
+            details->inner_gaps_y = inner_gaps_y;
+            details->outer_gaps_x = 0;
+            details->outer_gaps_y = 0;
+            details->resize_jump = 0;
+            details->animations_enabled = false;
+            details->border_config = border_config;
+            details->animation_defintions = animations;
+            return details;
+        }
+
+    public:
+        /// Calls the listeners that were registered for any of [sections], in the order
+        /// that they were registered.
+        void notify(ConfigSection sections)
+        {
+            ConfigChange const change { .current = snapshot(), .sections = sections };
+            for (auto const& [listener, listener_sections] : listeners)
+            {
+                if (listener && (listener_sections & sections) != ConfigSection::none)
+                    listener(change);
+            }
+        }
+
+        int inner_gaps_x = 0;
+        int inner_gaps_y = 0;
+
     private:
+        std::vector<std::pair<std::function<void(ConfigChange const&)>, ConfigSection>> listeners;
         miracle::BorderConfig border_config;
         std::array<AnimationDefinition, (int)AnimateableEvent::max> animations;
     };
@@ -0,0 +1,119 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef MIRACLE_WM_STUB_WINDOW_CONTROLLER_H
+#define MIRACLE_WM_STUB_WINDOW_CONTROLLER_H
+
+#include "container.h"
+#include "tiling_window_tree.h"
+#include "window_controller.h"
+#include <miral/window_info.h>
+#include <utility>
+#include <vector>
+
+namespace miracle::test
+{
+/// Provides a single zone covering [area] and no workspace.
+class StubTilingWindowTreeInterface : public TilingWindowTreeInterface
+{
+public:
+    explicit StubTilingWindowTreeInterface(geom::Rectangle const& area) :
+        zones { area }
+    {
+    }
+
+    std::vector<miral::Zone> const& get_zones() override
+    {
+        return zones;
+    }
+
+    Workspace* get_workspace() const override
+    {
+        return nullptr;
+    }
+
+private:
+    std::vector<miral::Zone> zones;
+};
+
+/// Looks containers up from [pairs] and ignores every request to change a window.
+class StubWindowController : public miracle::WindowController
+{
+public:
+    explicit StubWindowController(std::vector<std::pair<miral::Window, std::shared_ptr<Container>>>& pairs) :
+        pairs { pairs }
+    {
+    }
+
+    bool is_fullscreen(miral::Window const&) override
+    {
+        return false;
+    }
+
+    void set_rectangle(miral::Window const&, geom::Rectangle const&, geom::Rectangle const&) override
+    {
+        moves++;
+    }
+
+    MirWindowState get_state(miral::Window const&) override
+    {
+        return mir_window_state_restored;
+    }
+
+    void change_state(miral::Window const&, MirWindowState state) override { }
+    void clip(miral::Window const&, geom::Rectangle const&) override { }
+    void noclip(miral::Window const&) override { }
+    void select_active_window(miral::Window const& window) override
+    {
+        selected = window;
+    }
+
+    std::shared_ptr<Container> get_container(miral::Window const& window) override
+    {
+        for (auto const& p : pairs)
+        {
+            if (p.first == window)
+                return p.second;
+        }
+        return nullptr;
+    }
+
+    void raise(miral::Window const&) override { }
+    void send_to_back(miral::Window const&) override { }
+    void open(miral::Window const&) override { }
+    void close(miral::Window const&) override { }
+    void on_animation(miracle::AnimationStepResult const& result, std::shared_ptr<Container> const&) override { }
+    void set_user_data(miral::Window const&, std::shared_ptr<void> const&) override { }
+    void modify(miral::Window const&, miral::WindowSpecification const&) override { }
+    miral::WindowInfo& info_for(miral::Window const&) override
+    {
+        return info;
+    }
+
+    /// The window that was last passed to [select_active_window].
+    miral::Window selected;
+
+    /// The number of times that [set_rectangle] has been called.
+    size_t moves = 0;
+
+private:
+    std::vector<std::pair<miral::Window, std::shared_ptr<Container>>>& pairs;
+    miral::WindowInfo info;
+};
+}
+
+#endif // MIRACLE_WM_STUB_WINDOW_CONTROLLER_H
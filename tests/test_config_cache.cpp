@@ -0,0 +1,107 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "config_cache.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace miracle;
+
+namespace
+{
+const std::string path = std::filesystem::current_path() / "test_cache.yaml";
+}
+
+class ConfigCacheTest : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        write("inner_gaps:\n  x: 33\n  y: 44\n");
+        std::filesystem::remove(cache.get_cache_path());
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove(path);
+        std::filesystem::remove(cache.get_cache_path());
+    }
+
+    static void write(std::string const& contents, std::ios::openmode mode = std::ios::trunc)
+    {
+        std::ofstream file(path, std::ios::out | mode);
+        file << contents;
+    }
+
+    static ConfigDetails make_details()
+    {
+        ConfigDetails details;
+        details.inner_gaps_x = 33;
+        details.inner_gaps_y = 44;
+        details.custom_key_commands.push_back({
+            { MirKeyboardAction::mir_keyboard_action_down, mir_input_event_modifier_meta, KEY_X },
+            "echo Hi"
+        });
+        details.startup_apps.push_back({ .command = "echo Hi", .restart_on_death = true });
+        details.environment_variables.push_back({ "KEY", "VALUE" });
+        details.border_config = { 2, glm::vec4(1.f), glm::vec4(0.5f) };
+        details.workspace_configs.push_back({ 3, ContainerType::stack });
+        return details;
+    }
+
+    ConfigCache cache { path };
+};
+
+TEST_F(ConfigCacheTest, MissingCacheIsNotLoaded)
+{
+    EXPECT_FALSE(cache.load());
+}
+
+TEST_F(ConfigCacheTest, StoredDetailsAreLoadedUnchanged)
+{
+    auto const details = make_details();
+    ASSERT_TRUE(cache.store(details, cache.read().value()));
+
+    auto const loaded = cache.load();
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(get_changed_sections(details, loaded.value()), ConfigSection::none);
+}
+
+TEST_F(ConfigCacheTest, CacheIsStaleWhenTheFileChanges)
+{
+    ASSERT_TRUE(cache.store(make_details(), cache.read().value()));
+    write("resize_jump: 10\n", std::ios::app);
+    EXPECT_FALSE(cache.load());
+}
+
+TEST_F(ConfigCacheTest, CacheIsStaleWhenTheFileChangesWhileParsing)
+{
+    auto const source = cache.read();
+    ASSERT_TRUE(source);
+    write("resize_jump: 10\n", std::ios::app);
+    ASSERT_TRUE(cache.store(make_details(), source.value()));
+    EXPECT_FALSE(cache.load());
+}
+
+TEST_F(ConfigCacheTest, DamagedCacheIsNotLoaded)
+{
+    ASSERT_TRUE(cache.store(make_details(), cache.read().value()));
+    auto const size = std::filesystem::file_size(cache.get_cache_path());
+    std::filesystem::resize_file(cache.get_cache_path(), size - 1);
+    EXPECT_FALSE(cache.load());
+}
@@ -77,6 +77,55 @@ TEST_F(I3CommandTest, TestFloatingParsing)
     ASSERT_EQ(scope[0].type, I3ScopeType::floating);
 }
 
+TEST_F(I3CommandTest, TestAppIdParsingCompilesRegex)
+{
+    std::string v = "[app_id=\"^firefox$\"]";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_EQ(scope[0].type, I3ScopeType::app_id);
+    ASSERT_NE(scope[0].compiled_regex, nullptr);
+    ASSERT_TRUE(scope[0].compiled_regex->matches("firefox"));
+    ASSERT_FALSE(scope[0].compiled_regex->matches("firefox-esr"));
+}
+
+TEST_F(I3CommandTest, TestConIdParsing)
+{
+    std::string v = "[con_id=\"12345\"]";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_EQ(scope[0].type, I3ScopeType::con_id);
+    ASSERT_EQ(scope[0].con_id.value(), 12345);
+    ASSERT_FALSE(scope[0].matches_focused);
+}
+
+TEST_F(I3CommandTest, TestFocusedConIdParsing)
+{
+    std::string v = "[con_id=\"__focused__\"]";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_EQ(scope[0].type, I3ScopeType::con_id);
+    ASSERT_FALSE(scope[0].con_id.has_value());
+    ASSERT_TRUE(scope[0].matches_focused);
+}
+
+TEST_F(I3CommandTest, TestRepeatedCriteriaShareCompiledRegex)
+{
+    std::string v = "[title=\"Terminal\"]";
+    int ptr;
+    auto first = I3Scope::parse(v, ptr);
+    auto second = I3Scope::parse(v, ptr);
+    ASSERT_EQ(first[0].compiled_regex, second[0].compiled_regex);
+}
+
+TEST_F(I3CommandTest, TestInvalidRegexDoesNotMatch)
+{
+    std::string v = "[title=\"(unclosed\"]";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_FALSE(scope[0].compiled_regex->is_valid());
+    ASSERT_FALSE(scope[0].compiled_regex->matches("(unclosed"));
+}
+
 TEST_F(I3CommandTest, CanParseSingleI3Command)
 {
     std::string v = "exec gedit";
@@ -103,4 +152,95 @@ TEST_F(I3CommandTest, CanParseSplitCommand)
     ASSERT_EQ(commands[0].commands.size(), 1);
     ASSERT_EQ(commands[0].commands[0].type, I3CommandType::split);
     ASSERT_EQ(commands[0].commands[0].arguments[0], "vertical");
-}
\ No newline at end of file
+}
+
+TEST_F(I3CommandTest, CanParseSemicolonSeparatedCommands)
+{
+    std::string v = "workspace 2; workspace 3";
+    auto commands = I3ScopedCommandList::parse(v);
+    ASSERT_EQ(commands.size(), 2);
+    ASSERT_EQ(commands[0].commands[0].type, I3CommandType::workspace);
+    ASSERT_EQ(commands[0].commands[0].arguments[0], "2");
+    ASSERT_EQ(commands[1].commands[0].type, I3CommandType::workspace);
+    ASSERT_EQ(commands[1].commands[0].arguments[0], "3");
+}
+
+TEST_F(I3CommandTest, ScopeAppliesToEveryCommandInList)
+{
+    std::string v = "[app_id=\"a;b\"] focus, move left";
+    auto commands = I3ScopedCommandList::parse(v);
+    ASSERT_EQ(commands.size(), 1);
+    ASSERT_EQ(commands[0].scope[0].type, I3ScopeType::app_id);
+    ASSERT_EQ(commands[0].scope[0].regex.value(), "a;b");
+    ASSERT_EQ(commands[0].commands.size(), 2);
+    ASSERT_EQ(commands[0].commands[0].type, I3CommandType::focus);
+    ASSERT_EQ(commands[0].commands[1].type, I3CommandType::move);
+    ASSERT_EQ(commands[0].commands[1].arguments[0], "left");
+}
+
+TEST_F(I3CommandTest, CanParseQuotedArguments)
+{
+    std::string v = "exec \"notify-send \\\"a, b; c\\\"\"";
+    auto commands = I3ScopedCommandList::parse(v);
+    ASSERT_EQ(commands.size(), 1);
+    ASSERT_EQ(commands[0].commands.size(), 1);
+    ASSERT_EQ(commands[0].commands[0].arguments.size(), 1);
+    ASSERT_EQ(commands[0].commands[0].arguments[0], "notify-send \"a, b; c\"");
+}
+
+TEST_F(I3CommandTest, CommandTypeMustMatchExactly)
+{
+    std::string v = "execute gedit";
+    auto commands = I3ScopedCommandList::parse(v);
+    ASSERT_EQ(commands[0].commands[0].type, I3CommandType::none);
+}
+
+TEST_F(I3CommandTest, ArgumentsOutliveTheInput)
+{
+    std::vector<I3ScopedCommandList> commands;
+    {
+        std::string v = "split vertical";
+        commands = I3ScopedCommandList::parse(v);
+    }
+
+    ASSERT_EQ(commands[0].commands[0].arguments[0], "vertical");
+}
+
+TEST_F(I3CommandTest, ScopeMissingClosingBracketStopsAtEnd)
+{
+    std::string_view v = "[title=\"x\"";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_EQ(ptr, v.size());
+    ASSERT_EQ(scope.size(), 1);
+    ASSERT_EQ(scope[0].regex.value(), "x");
+}
+
+TEST_F(I3CommandTest, ScopeMissingClosingQuoteStopsAtEnd)
+{
+    std::string_view v = "[title=\"x";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_EQ(ptr, v.size());
+    ASSERT_TRUE(scope.empty());
+}
+
+TEST_F(I3CommandTest, ValuelessScopeAtEndOfViewIsIgnored)
+{
+    std::string_view v = "[all";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_EQ(ptr, v.size());
+    ASSERT_TRUE(scope.empty());
+}
+
+TEST_F(I3CommandTest, ValuelessScopesSeparatedBySpaces)
+{
+    std::string_view v = "[floating tiling]";
+    int ptr;
+    auto scope = I3Scope::parse(v, ptr);
+    ASSERT_EQ(v[ptr], ']');
+    ASSERT_EQ(scope.size(), 2);
+    ASSERT_EQ(scope[0].type, I3ScopeType::floating);
+    ASSERT_EQ(scope[1].type, I3ScopeType::tiling);
+}
@@ -0,0 +1,136 @@
+/**
+Copyright (C) 2024  Matthew Kosarek
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "i3_command.h"
+#include "stub_session.h"
+#include "stub_surface.h"
+#include "window_index.h"
+#include <gtest/gtest.h>
+
+using namespace miracle;
+
+class WindowIndexTest : public testing::Test
+{
+public:
+    miral::Window add_window(WindowIndexEntry const& entry)
+    {
+        auto session = std::make_shared<test::StubSession>();
+        sessions.push_back(session);
+        auto surface = std::make_shared<test::StubSurface>();
+        surfaces.push_back(surface);
+
+        miral::Window window(session, surface);
+        index.update(window, entry);
+        return window;
+    }
+
+    static std::vector<I3Scope> parse_scope(std::string const& v)
+    {
+        int ptr = 0;
+        return I3Scope::parse(v, ptr);
+    }
+
+    WindowIndex index;
+    std::vector<std::shared_ptr<test::StubSession>> sessions;
+    std::vector<std::shared_ptr<test::StubSurface>> surfaces;
+};
+
+TEST_F(WindowIndexTest, AnchoredAppIdResolvesToMatchingWindows)
+{
+    auto firefox = add_window({ .app_id = "firefox", .container_id = 1, .container_type = ContainerType::leaf });
+    add_window({ .app_id = "kitty", .container_id = 2, .container_type = ContainerType::leaf });
+
+    auto candidates = index.find_candidates(parse_scope("[app_id=\"^firefox$\"]"));
+    ASSERT_EQ(candidates.size(), 1);
+    ASSERT_EQ(candidates[0], firefox);
+}
+
+TEST_F(WindowIndexTest, AnchoredPrefixResolvesToRange)
+{
+    add_window({ .app_id = "org.gnome.Nautilus", .container_id = 1, .container_type = ContainerType::leaf });
+    add_window({ .app_id = "org.gnome.Terminal", .container_id = 2, .container_type = ContainerType::leaf });
+    add_window({ .app_id = "kitty", .container_id = 3, .container_type = ContainerType::leaf });
+
+    auto candidates = index.find_candidates(parse_scope("[app_id=\"^org\\.gnome\"]"));
+    ASSERT_EQ(candidates.size(), 2);
+}
+
+TEST_F(WindowIndexTest, ConIdResolvesToSingleWindow)
+{
+    add_window({ .app_id = "kitty", .container_id = 1, .container_type = ContainerType::leaf });
+    auto second = add_window({ .app_id = "kitty", .container_id = 2, .container_type = ContainerType::leaf });
+
+    auto candidates = index.find_candidates(parse_scope("[con_id=\"2\"]"));
+    ASSERT_EQ(candidates.size(), 1);
+    ASSERT_EQ(candidates[0], second);
+    ASSERT_TRUE(index.find_candidates(parse_scope("[con_id=\"3\"]")).empty());
+}
+
+TEST_F(WindowIndexTest, FloatingResolvesToFloatingWindows)
+{
+    add_window({ .app_id = "kitty", .container_id = 1, .container_type = ContainerType::leaf });
+    auto floating = add_window({ .app_id = "kitty", .container_id = 2, .container_type = ContainerType::floating_window });
+
+    auto candidates = index.find_candidates(parse_scope("[floating]"));
+    ASSERT_EQ(candidates.size(), 1);
+    ASSERT_EQ(candidates[0], floating);
+}
+
+TEST_F(WindowIndexTest, UnindexedCriteriaReturnsEveryWindow)
+{
+    add_window({ .app_id = "kitty", .title = "one", .container_id = 1, .container_type = ContainerType::leaf });
+    add_window({ .app_id = "kitty", .title = "two", .container_id = 2, .container_type = ContainerType::leaf });
+
+    auto candidates = index.find_candidates(parse_scope("[title=\"o\"]"));
+    ASSERT_EQ(candidates.size(), 2);
+}
+
+TEST_F(WindowIndexTest, UpdateReplacesPreviousEntry)
+{
+    auto window = add_window({ .app_id = "kitty", .container_id = 1, .container_type = ContainerType::leaf });
+    index.update(window, { .app_id = "kitty", .container_id = 2, .container_type = ContainerType::floating_window });
+
+    ASSERT_EQ(index.size(), 1);
+    ASSERT_TRUE(index.find_candidates(parse_scope("[con_id=\"1\"]")).empty());
+    ASSERT_TRUE(index.find_candidates(parse_scope("[tiling]")).empty());
+    ASSERT_EQ(index.find_candidates(parse_scope("[con_id=\"2\"]")).size(), 1);
+}
+
+TEST_F(WindowIndexTest, RemovedWindowIsNotACandidate)
+{
+    auto window = add_window({ .app_id = "kitty", .container_id = 1, .container_type = ContainerType::leaf });
+    index.remove(window);
+
+    ASSERT_EQ(index.size(), 0);
+    ASSERT_TRUE(index.find_candidates(parse_scope("[app_id=\"^kitty$\"]")).empty());
+}
+
+TEST_F(WindowIndexTest, CandidatesAreSortedByMostRecentFocus)
+{
+    auto newer = add_window({ .app_id = "kitty", .container_id = 1, .container_type = ContainerType::leaf });
+    auto older = add_window({ .app_id = "kitty", .container_id = 2, .container_type = ContainerType::leaf });
+    auto never = add_window({ .app_id = "kitty", .container_id = 3, .container_type = ContainerType::leaf });
+    index.mark_focused(older);
+    index.mark_focused(newer);
+
+    // Focus order is kept when the entry changes
+    index.update(newer, { .app_id = "kitty", .container_id = 1, .container_type = ContainerType::floating_window });
+
+    auto candidates = index.find_candidates(parse_scope("[app_id=\"^kitty$\"]"));
+    index.sort_by_focus(candidates);
+    ASSERT_EQ(candidates, (std::vector<miral::Window> { newer, older, never }));
+}
@@ -16,10 +16,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
 #include "compositor_state.h"
+#include "container_snapshot.h"
+#include "geometric_selection.h"
+#include "layout_transaction.h"
 #include "leaf_container.h"
 #include "stub_configuration.h"
 #include "stub_session.h"
 #include "stub_surface.h"
+#include "stub_window_controller.h"
 #include "tiling_window_tree.h"
 #include "window_controller.h"
 #include <gtest/gtest.h>
@@ -35,84 +39,23 @@ geom::Rectangle r {
 };
 }
 
-class SimpleTilingWindowTreeInterface : public TilingWindowTreeInterface
-{
-public:
-    std::vector<miral::Zone> const& get_zones() override
-    {
-        return zones;
-    }
-
-    Workspace* get_workspace() const override
-    {
-        return nullptr;
-    }
-
-private:
-    std::vector<miral::Zone> zones = { r };
-};
-
-class StubWindowController : public miracle::WindowController
-{
-public:
-    StubWindowController(std::vector<std::pair<miral::Window, std::shared_ptr<Container>>>& pairs) :
-        pairs { pairs }
-    {
-    }
-    bool is_fullscreen(miral::Window const&) override
-    {
-        return false;
-    }
-    void set_rectangle(miral::Window const&, geom::Rectangle const&, geom::Rectangle const&) override { }
-    MirWindowState get_state(miral::Window const&) override
-    {
-        return mir_window_state_restored;
-    }
-
-    void change_state(miral::Window const&, MirWindowState state) override { }
-    void clip(miral::Window const&, geom::Rectangle const&) override { }
-    void noclip(miral::Window const&) override { }
-    void select_active_window(miral::Window const&) override { }
-    std::shared_ptr<Container> get_container(miral::Window const& window) override
-    {
-        for (auto const& p : pairs)
-        {
-            if (p.first == window)
-                return p.second;
-        }
-        return nullptr;
-    }
-
-    void raise(miral::Window const&) override { }
-    void send_to_back(miral::Window const&) override { }
-    void open(miral::Window const&) override { }
-    void close(miral::Window const&) override { }
-    void on_animation(miracle::AnimationStepResult const& result, std::shared_ptr<Container> const&) override { }
-    void set_user_data(miral::Window const&, std::shared_ptr<void> const&) override { }
-    void modify(miral::Window const&, miral::WindowSpecification const&) override { }
-    miral::WindowInfo& info_for(miral::Window const&) override { }
-
-private:
-    std::vector<std::pair<miral::Window, std::shared_ptr<Container>>>& pairs;
-};
-
 class TilingWindowTreeTest : public testing::Test
 {
 public:
     TilingWindowTreeTest() :
         tree(
-            std::make_unique<SimpleTilingWindowTreeInterface>(),
+            std::make_unique<test::StubTilingWindowTreeInterface>(r),
             window_controller,
             state,
-            std::make_shared<test::StubConfiguration>(),
+            config,
             r)
     {
     }
 
-    std::shared_ptr<LeafContainer> create_leaf()
+    std::shared_ptr<LeafContainer> create_leaf(std::shared_ptr<ParentContainer> const& parent = nullptr)
     {
         miral::WindowSpecification spec;
-        spec = tree.place_new_window(spec, nullptr);
+        spec = tree.place_new_window(spec, parent);
 
         auto session = std::make_shared<test::StubSession>();
         sessions.push_back(session);
@@ -122,7 +65,7 @@ public:
         miral::Window window(session, surface);
         miral::WindowInfo info(window, spec);
 
-        auto leaf = tree.confirm_window(info, nullptr);
+        auto leaf = tree.confirm_window(info, parent);
         pairs.push_back({ window, leaf });
 
         state.active = leaf;
@@ -134,7 +77,8 @@ public:
     std::vector<std::shared_ptr<test::StubSession>> sessions;
     std::vector<std::shared_ptr<test::StubSurface>> surfaces;
     std::vector<std::pair<miral::Window, std::shared_ptr<Container>>> pairs;
-    StubWindowController window_controller { pairs };
+    test::StubWindowController window_controller { pairs };
+    std::shared_ptr<test::StubConfiguration> config = std::make_shared<test::StubConfiguration>();
     TilingWindowTree tree;
 };
 
@@ -177,12 +121,261 @@ TEST_F(TilingWindowTreeTest, can_add_three_windows_horizontally_without_border_a
     auto leaf2 = create_leaf();
     auto leaf3 = create_leaf();
 
-    ASSERT_EQ(leaf1->get_logical_area().size, geom::Size(ceilf(1280 / 3.f), 720));
+    // Each edge is rounded to the nearest pixel: 1280 / 3 = 426.67 and 1280 * 2 / 3 = 853.33
+    ASSERT_EQ(leaf1->get_logical_area().size, geom::Size(427, 720));
+    ASSERT_EQ(leaf1->get_logical_area().top_left, geom::Point(0, 0));
+
+    ASSERT_EQ(leaf2->get_logical_area().size, geom::Size(426, 720));
+    ASSERT_EQ(leaf2->get_logical_area().top_left, geom::Point(427, 0));
+
+    ASSERT_EQ(leaf3->get_logical_area().size, geom::Size(427, 720));
+    ASSERT_EQ(leaf3->get_logical_area().top_left, geom::Point(853, 0));
+}
+
+TEST_F(TilingWindowTreeTest, removing_a_window_restores_an_even_split)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    auto leaf3 = create_leaf();
+
+    tree.advise_delete_window(leaf2);
+
+    ASSERT_EQ(leaf1->get_logical_area().size, geom::Size(1280 / 2.f, 720));
     ASSERT_EQ(leaf1->get_logical_area().top_left, geom::Point(0, 0));
 
-    ASSERT_EQ(leaf2->get_logical_area().size, geom::Size(ceilf(1280 / 3.f), 720));
-    ASSERT_EQ(leaf2->get_logical_area().top_left, geom::Point(ceilf(1280 / 3.f), 0));
+    ASSERT_EQ(leaf3->get_logical_area().size, geom::Size(1280 / 2.f, 720));
+    ASSERT_EQ(leaf3->get_logical_area().top_left, geom::Point(1280 / 2.f, 0));
+}
+
+TEST_F(TilingWindowTreeTest, layout_is_committed_once_the_transaction_ends)
+{
+    auto leaf1 = create_leaf();
+    {
+        LayoutTransaction transaction;
+        auto leaf2 = create_leaf();
+
+        // The new layout is decided, but it has not been pushed to the window yet
+        ASSERT_EQ(leaf1->get_logical_area().size, geom::Size(1280 / 2.f, 720));
+        ASSERT_EQ(leaf1->get_visible_area().size, geom::Size(1280, 720));
+    }
+
+    ASSERT_EQ(leaf1->get_visible_area().size, geom::Size(1280 / 2.f, 720));
+}
+
+TEST_F(TilingWindowTreeTest, nested_transactions_commit_when_the_outermost_ends)
+{
+    auto leaf1 = create_leaf();
+    {
+        LayoutTransaction outer;
+        {
+            LayoutTransaction inner;
+            create_leaf();
+        }
+
+        ASSERT_EQ(leaf1->get_visible_area().size, geom::Size(1280, 720));
+    }
+
+    ASSERT_EQ(leaf1->get_visible_area().size, geom::Size(1280 / 2.f, 720));
+}
+
+TEST_F(TilingWindowTreeTest, parents_are_laid_out_when_the_transaction_ends)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    {
+        LayoutTransaction transaction;
+        tree.get_root()->set_layout(LayoutScheme::vertical);
+        tree.get_root()->set_layout(LayoutScheme::horizontal);
+        tree.get_root()->set_layout(LayoutScheme::vertical);
+
+        // The scheme has changed, but the areas of the sub nodes have not been calculated yet
+        ASSERT_EQ(leaf1->get_logical_area().size, geom::Size(1280 / 2.f, 720));
+
+        LayoutTransaction::apply_layouts();
+        ASSERT_EQ(leaf1->get_logical_area().size, geom::Size(1280, 720 / 2.f));
+        ASSERT_EQ(leaf1->get_visible_area().size, geom::Size(1280 / 2.f, 720));
+    }
+
+    ASSERT_EQ(leaf1->get_visible_area().size, geom::Size(1280, 720 / 2.f));
+    ASSERT_EQ(leaf2->get_visible_area().top_left, geom::Point(0, 720 / 2.f));
+}
+
+TEST_F(TilingWindowTreeTest, window_is_selected_from_a_point)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    auto leaf3 = create_leaf();
+
+    ASSERT_EQ(tree.select_window_from_point(0, 0), leaf1);
+    ASSERT_EQ(tree.select_window_from_point(427, 360), leaf2);
+    ASSERT_EQ(tree.select_window_from_point(1279, 719), leaf3);
+    ASSERT_EQ(tree.select_window_from_point(1280, 0), nullptr);
+}
+
+TEST_F(TilingWindowTreeTest, only_the_shown_tab_is_selected_from_a_point)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    tree.get_root()->set_layout(LayoutScheme::tabbing);
+
+    tree.advise_focus_gained(*leaf2);
+    ASSERT_EQ(tree.select_window_from_point(100, 100), leaf2);
+
+    tree.advise_focus_gained(*leaf1);
+    ASSERT_EQ(tree.select_window_from_point(100, 100), leaf1);
+}
+
+TEST_F(TilingWindowTreeTest, nothing_is_selected_from_a_point_in_a_gap)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    config->inner_gaps_x = 10;
+    config->notify(ConfigSection::gaps);
+
+    ASSERT_EQ(tree.select_window_from_point(634, 360), leaf1);
+    ASSERT_EQ(tree.select_window_from_point(640, 360), nullptr);
+    ASSERT_EQ(tree.select_window_from_point(645, 360), leaf2);
+}
+
+TEST_F(TilingWindowTreeTest, leaves_are_visited_in_order_until_the_visitor_stops)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    auto leaf3 = create_leaf();
+
+    std::vector<LeafContainer const*> visited;
+    bool const stopped = tree.for_each_leaf([&](LeafContainer& leaf)
+    {
+        visited.push_back(&leaf);
+        return &leaf == leaf2.get();
+    });
+
+    ASSERT_TRUE(stopped);
+    ASSERT_EQ(visited, (std::vector<LeafContainer const*> { leaf1.get(), leaf2.get() }));
+
+    Container const* last = nullptr;
+    tree.for_each_node([&](Container& container)
+    { last = &container; }, TraversalOrder::post);
+    ASSERT_EQ(last, tree.get_root().get());
+}
+
+TEST_F(TilingWindowTreeTest, selecting_into_a_lane_returns_to_the_window_last_focused_there)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    tree.request_vertical_layout(*leaf2);
+    auto lane = leaf2->get_parent().lock();
+    auto leaf3 = create_leaf(lane);
+
+    ASSERT_EQ(leaf2->get_index_in_parent(), 0);
+    ASSERT_EQ(leaf3->get_index_in_parent(), 1);
+    ASSERT_EQ(lane->get_index_in_parent(), 1);
+
+    // Without the focus memory, moving right would enter the lane at its top
+    tree.advise_focus_gained(*leaf1);
+    ASSERT_TRUE(tree.select_next(Direction::right, *leaf1));
+    ASSERT_EQ(window_controller.selected, leaf3->window().value());
+}
+
+TEST_F(TilingWindowTreeTest, nearest_window_is_found_from_the_geometry)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    tree.request_vertical_layout(*leaf2);
+    auto leaf3 = create_leaf(leaf2->get_parent().lock());
+
+    // leaf1 fills the left half, while leaf2 is above leaf3 on the right
+    ASSERT_EQ(find_nearest_leaf(tree, leaf3->get_visible_area(), Direction::up, leaf3.get()), leaf2);
+    ASSERT_EQ(find_nearest_leaf(tree, leaf3->get_visible_area(), Direction::left, leaf3.get()), leaf1);
+    ASSERT_EQ(find_nearest_leaf(tree, leaf2->get_visible_area(), Direction::down, leaf2.get()), leaf3);
+    ASSERT_EQ(find_nearest_leaf(tree, leaf1->get_visible_area(), Direction::left, leaf1.get()), nullptr);
+
+    // leaf2 only touches the corner of a rectangle that starts where it ends, so leaf3,
+    // which is level with it, is chosen even though the center of leaf2 is closer
+    auto const& right = leaf2->get_parent().lock();
+    right->set_sizes({ 200, 520 });
+    right->commit_changes();
+    geom::Rectangle const beside { geom::Point(1280, 200), geom::Size(100, 100) };
+    ASSERT_EQ(find_nearest_leaf(tree, beside, Direction::left), leaf3);
+}
+
+TEST_F(TilingWindowTreeTest, committing_only_moves_windows_whose_area_changed)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    auto const& root = tree.get_root();
+
+    window_controller.moves = 0;
+    root->set_sizes({ 640, 640 });
+    root->commit_changes();
+    ASSERT_EQ(window_controller.moves, 0);
 
-    ASSERT_EQ(leaf3->get_logical_area().size, geom::Size(floorf(1280 / 3.f), 720));
-    ASSERT_EQ(leaf3->get_logical_area().top_left, geom::Point(floorf(1280 * (2.f / 3.f)) - 1, 0));
-}
\ No newline at end of file
+    root->set_sizes({ 320, 960 });
+    root->commit_changes();
+    ASSERT_EQ(window_controller.moves, 2);
+}
+
+TEST_F(TilingWindowTreeTest, snapshots_are_stored_in_pre_order_and_reuse_the_buffer)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    tree.request_vertical_layout(*leaf2);
+    auto lane = leaf2->get_parent().lock();
+    auto leaf3 = create_leaf(lane);
+
+    ContainerSnapshotBuffer buffer;
+    tree.get_root()->snapshot(buffer);
+    auto snapshots = buffer.get();
+    ASSERT_EQ(snapshots.size(), 5);
+
+    ASSERT_EQ(snapshots[0].type, ContainerType::parent);
+    ASSERT_EQ(snapshots[0].child_count, 2);
+    ASSERT_EQ(snapshots[0].descendant_count, 4);
+    ASSERT_EQ(snapshots[1].id, reinterpret_cast<std::uintptr_t>(leaf1.get()));
+    ASSERT_EQ(snapshots[1].visible_area, leaf1->get_visible_area());
+    ASSERT_EQ(snapshots[2].id, reinterpret_cast<std::uintptr_t>(lane.get()));
+    ASSERT_EQ(snapshots[2].layout, LayoutScheme::vertical);
+    ASSERT_EQ(snapshots[2].descendant_count, 2);
+    ASSERT_EQ(snapshots[3].id, reinterpret_cast<std::uintptr_t>(leaf2.get()));
+    ASSERT_EQ(snapshots[4].id, reinterpret_cast<std::uintptr_t>(leaf3.get()));
+
+    buffer.clear();
+    lane->snapshot(buffer);
+    ASSERT_EQ(buffer.size(), 3);
+    ASSERT_EQ(buffer.get().data(), snapshots.data());
+}
+
+TEST_F(TilingWindowTreeTest, tree_with_windows_is_serialized_to_json)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    tree.request_vertical_layout(*leaf2);
+
+    auto const json = tree.get_root()->to_json();
+    ASSERT_EQ(json["layout"], "splith");
+    ASSERT_EQ(json["nodes"].size(), 2);
+    ASSERT_EQ(json["nodes"][0]["id"], reinterpret_cast<std::uintptr_t>(leaf1.get()));
+    ASSERT_EQ(json["nodes"][0]["layout"], "none");
+    ASSERT_EQ(json["nodes"][0]["type"], "con");
+    ASSERT_EQ(json["nodes"][1]["layout"], "splitv");
+    ASSERT_EQ(json["nodes"][1]["nodes"][0]["id"], reinterpret_cast<std::uintptr_t>(leaf2.get()));
+    ASSERT_EQ(leaf2->to_json()["layout"], "none");
+}
+
+TEST_F(TilingWindowTreeTest, changing_the_inner_gaps_moves_every_window)
+{
+    auto leaf1 = create_leaf();
+    auto leaf2 = create_leaf();
+    tree.request_vertical_layout(*leaf2);
+    auto leaf3 = create_leaf(leaf2->get_parent().lock());
+    ASSERT_EQ(leaf1->get_visible_area().size.width.as_int(), 640);
+
+    // The placement areas are unchanged, but each window gains a gap beside its neighbors
+    window_controller.moves = 0;
+    config->inner_gaps_x = 10;
+    config->notify(ConfigSection::gaps);
+
+    ASSERT_EQ(window_controller.moves, 3);
+    ASSERT_EQ(leaf1->get_visible_area().size.width.as_int(), 635);
+    ASSERT_EQ(leaf3->get_visible_area().top_left.x.as_int(), 645);
+}